@@ -0,0 +1,429 @@
+// Benchmarks of the spline solver, the patch evaluators and the allocations of a knot drag, and the accuracy of the uniform sampler.
+// Built with -DBUILD_BENCHMARKS=ON, prints its measurements and returns 1 if a result is wrong.
+
+#include "Bezier.h"
+#include "BezierBatch.h"
+#include "BezierEvaluator.h"
+#include "Spline.h"
+#include "TridiagonalSolver.h"
+
+#include <QElapsedTimer>
+#include <QPair>
+#include <QRandomGenerator>
+#include <QVector>
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if defined(_MSC_VER) && defined(_DEBUG)
+#include <crtdbg.h>
+#endif
+
+namespace
+{
+    // Every new expression goes through the replaced operators below. Qt containers allocate their storage with
+    // malloc, which is counted as well where the C runtime can be hooked.
+    std::atomic<quint64> gNewCount { 0 };
+    std::atomic<quint64> gMallocCount { 0 };
+    bool gMallocCountAvailable = false;
+}
+
+void* operator new(std::size_t size)
+{
+    gNewCount++;
+
+    if (void* pointer = std::malloc(size ? size : 1))
+        return pointer;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    gNewCount++;
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
+
+#if defined(_MSC_VER) && defined(_DEBUG)
+static int AllocationHook(int type, void*, size_t, int, long, const unsigned char*, int)
+{
+    if (type == _HOOK_ALLOC || type == _HOOK_REALLOC)
+        gMallocCount++;
+
+    return TRUE;
+}
+#elif defined(__GLIBC__)
+// The glibc entry points stay reachable under their internal names, free needs no counting and is left alone
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* pointer, size_t size);
+
+extern "C" void* malloc(size_t size)
+{
+    gMallocCount++;
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+    gMallocCount++;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* pointer, size_t size)
+{
+    gMallocCount++;
+    return __libc_realloc(pointer, size);
+}
+#endif
+
+using namespace BSplineCurves3D;
+
+static QVector3D RandomPoint(float range)
+{
+    QRandomGenerator* generator = QRandomGenerator::global();
+
+    return QVector3D(generator->bounded(2 * range) - range, generator->bounded(2 * range) - range, generator->bounded(2 * range) - range);
+}
+
+static bool BenchmarkSolver()
+{
+    std::printf("Tridiagonal solver, time per solve and largest residual of the 1-4-1 system\n");
+
+    bool passed = true;
+
+    for (int size : { 10, 1000, 10000, 100000 })
+    {
+        QVector<QVector3D> constants(size);
+        QVector<QVector3D> solution(size);
+
+        for (auto& constant : constants)
+            constant = RandomPoint(100.0f);
+
+        for (bool cyclic : { false, true })
+        {
+            const int repetitions = qMax(1, 10000000 / size);
+
+            QElapsedTimer timer;
+            timer.start();
+
+            for (int i = 0; i < repetitions; ++i)
+            {
+                if (cyclic)
+                    TridiagonalSolver::SolveCyclic(constants.constData(), solution.data(), size);
+                else
+                    TridiagonalSolver::Solve(constants.constData(), solution.data(), size);
+            }
+
+            const double nanoseconds = double(timer.nsecsElapsed()) / repetitions;
+
+            // Relative to the constants, which are at most 100 in magnitude
+            float residual = 0.0f;
+
+            for (int i = 0; i < size; ++i)
+            {
+                QVector3D product = 4 * solution[i];
+
+                if (i > 0 || cyclic)
+                    product += solution[(i + size - 1) % size];
+
+                if (i < size - 1 || cyclic)
+                    product += solution[(i + 1) % size];
+
+                residual = qMax(residual, (product - constants[i]).length() / 100.0f);
+            }
+
+            passed &= residual < 1e-5f;
+
+            std::printf("  %-6s n = %6d: %12.1f ns, %8.3f ns per unknown, residual %.2g\n", cyclic ? "closed" : "open", size, nanoseconds, nanoseconds / size, residual);
+        }
+    }
+
+    return passed;
+}
+
+static bool BenchmarkEvaluators()
+{
+    std::printf("Cubic patch evaluation (%s), time per sample and largest error against double precision\n", BezierBatch::GetInstructionSetName());
+
+    QVector3D points[4];
+
+    for (auto& point : points)
+        point = RandomPoint(50.0f);
+
+    auto reference = [&](double t, int j) {
+        const double s = 1 - t;
+        return s * s * s * points[0][j] + 3 * s * s * t * points[1][j] + 3 * s * t * t * points[2][j] + t * t * t * points[3][j];
+    };
+
+    bool passed = true;
+
+    for (int segments : { 100, 256 })
+    {
+        const int count = segments + 1;
+        const int repetitions = 2000000 / count;
+
+        QVector<float> x(count), y(count), z(count), dx(count), dy(count), dz(count);
+        QVector<QVector3D> values(count);
+
+        // The Factorial and pow based Bernstein sum that Bezier::ValueAt uses for degrees other than 3
+        QElapsedTimer timer;
+        timer.start();
+
+        for (int r = 0; r < repetitions / 20; ++r)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                const float t = float(i) / segments;
+                QVector3D value;
+
+                for (int k = 0; k <= 3; ++k)
+                    value += Bezier::Choose(3, k) * std::pow(t, k) * std::pow(1 - t, 3 - k) * points[k];
+
+                values[i] = value;
+            }
+        }
+
+        const double generic = double(timer.nsecsElapsed()) / (repetitions / 20) / count;
+
+        timer.restart();
+
+        for (int r = 0; r < repetitions; ++r)
+            for (int i = 0; i < count; ++i)
+                values[i] = CubicBezierEvaluator::ValueAt(points, float(i) / segments);
+
+        const double cubic = double(timer.nsecsElapsed()) / repetitions / count;
+
+        timer.restart();
+
+        for (int r = 0; r < repetitions; ++r)
+            BezierBatch::EvaluateCubicUniform(points, segments, x.data(), y.data(), z.data(), dx.data(), dy.data(), dz.data());
+
+        const double uniform = double(timer.nsecsElapsed()) / repetitions / count;
+
+        // Horner evaluation of the same ticks, what the uniform sampler replaces
+        QVector<float> t(count);
+
+        for (int i = 0; i < count; ++i)
+            t[i] = float(i) / segments;
+
+        timer.restart();
+
+        for (int r = 0; r < repetitions; ++r)
+            BezierBatch::EvaluateCubic(points, t.constData(), count, x.data(), y.data(), z.data(), dx.data(), dy.data(), dz.data());
+
+        const double horner = double(timer.nsecsElapsed()) / repetitions / count;
+
+        BezierBatch::EvaluateCubicUniform(points, segments, x.data(), y.data(), z.data(), dx.data(), dy.data(), dz.data());
+
+        double cubicError = 0;
+        double uniformError = 0;
+
+        for (int i = 0; i < count; ++i)
+        {
+            const double t = double(i) / segments;
+            const float uniformValue[3] = { x[i], y[i], z[i] };
+
+            for (int j = 0; j < 3; ++j)
+            {
+                cubicError = qMax(cubicError, std::abs(values[i][j] - reference(t, j)));
+                uniformError = qMax(uniformError, std::abs(uniformValue[j] - reference(t, j)));
+            }
+        }
+
+        // Control points are at most 50 away from the origin, float rounding stays far below 1e-4
+        passed &= cubicError < 1e-4 && uniformError < 1e-4;
+
+        std::printf("  %3d segments: generic %7.2f ns, cubic %5.2f ns, with derivatives: batch Horner %5.2f ns, uniform %5.2f ns, error cubic %.2g, uniform %.2g\n",
+                    segments,
+                    generic,
+                    cubic,
+                    horner,
+                    uniform,
+                    cubicError,
+                    uniformError);
+    }
+
+    return passed;
+}
+
+static bool CheckUniformAccuracy()
+{
+    std::printf("Forward differenced uniform ticks, largest error against CubicBezierEvaluator relative to the largest value\n");
+
+    bool passed = true;
+
+    for (int segments : { 1000, 10000, 100000 })
+    {
+        const int count = segments + 1;
+
+        QVector<float> x(count), y(count), z(count), dx(count), dy(count), dz(count);
+
+        float valueError = 0.0f;
+        float derivativeError = 0.0f;
+
+        for (int patch = 0; patch < 100; ++patch)
+        {
+            QVector3D points[4];
+
+            for (auto& point : points)
+                point = RandomPoint(50.0f);
+
+            BezierBatch::EvaluateCubicUniform(points, segments, x.data(), y.data(), z.data(), dx.data(), dy.data(), dz.data());
+
+            float valueScale = 0.0f;
+            float derivativeScale = 0.0f;
+            float patchValueError = 0.0f;
+            float patchDerivativeError = 0.0f;
+
+            for (int i = 0; i < count; ++i)
+            {
+                const float t = float(i) / segments;
+                const QVector3D value = CubicBezierEvaluator::ValueAt(points, t);
+                const QVector3D derivative = CubicBezierEvaluator::DerivativeAt(points, t);
+
+                valueScale = qMax(valueScale, value.length());
+                derivativeScale = qMax(derivativeScale, derivative.length());
+                patchValueError = qMax(patchValueError, (QVector3D(x[i], y[i], z[i]) - value).length());
+                patchDerivativeError = qMax(patchDerivativeError, (QVector3D(dx[i], dy[i], dz[i]) - derivative).length());
+            }
+
+            valueError = qMax(valueError, patchValueError / valueScale);
+            derivativeError = qMax(derivativeError, patchDerivativeError / derivativeScale);
+        }
+
+        // The direct evaluator itself is only accurate to a few float roundings
+        passed &= valueError < 1e-5f && derivativeError < 1e-5f;
+
+        std::printf("  %6d segments: value %.2g, derivative %.2g\n", segments, valueError, derivativeError);
+    }
+
+    return passed;
+}
+
+static bool BenchmarkAllocations()
+{
+    std::printf("Allocations of 1000 knot drags on a 10000 knot spline\n");
+
+    for (bool closed : { false, true })
+    {
+        Spline spline;
+        QList<KnotPoint*> knots;
+
+        for (int i = 0; i < 10000; ++i)
+        {
+            knots << new KnotPoint(RandomPoint(100.0f));
+            spline.AddKnotPoint(knots.last());
+        }
+
+        spline.SetClosed(closed);
+        spline.Update();
+
+        // Small moves take the windowed solve, every 100th move is large enough for a wide window
+        QVector<QPair<int, QVector3D>> drags;
+
+        for (int i = 0; i < 1000; ++i)
+            drags << qMakePair(int(QRandomGenerator::global()->bounded(knots.size())), RandomPoint(i % 100 == 0 ? 10.0f : 0.1f));
+
+        // The first pass sizes the scratch buffers and caches the factorizations of the window sizes, the second is measured
+        quint64 newAllocations = 0;
+        quint64 mallocAllocations = 0;
+        double microseconds = 0;
+
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            const quint64 newBefore = gNewCount.load();
+            const quint64 mallocBefore = gMallocCount.load();
+
+            QElapsedTimer timer;
+            timer.start();
+
+            for (const auto& drag : drags)
+            {
+                KnotPoint* knot = knots[drag.first];
+                knot->SetPosition(knot->GetPosition() + drag.second);
+                spline.Update();
+            }
+
+            microseconds = double(timer.nsecsElapsed()) / drags.size() / 1000;
+            newAllocations = gNewCount.load() - newBefore;
+            mallocAllocations = gMallocCount.load() - mallocBefore;
+        }
+
+        if (gMallocCountAvailable)
+            std::printf("  %-6s %8.1f us per drag, %llu operator new calls, %llu allocations in total including Qt containers\n",
+                        closed ? "closed" : "open",
+                        microseconds,
+                        static_cast<unsigned long long>(newAllocations),
+                        static_cast<unsigned long long>(mallocAllocations));
+        else
+            std::printf("  %-6s %8.1f us per drag, %llu operator new calls, Qt container storage not counted without glibc or an MSVC debug build\n",
+                        closed ? "closed" : "open",
+                        microseconds,
+                        static_cast<unsigned long long>(newAllocations));
+    }
+
+    return true;
+}
+
+int main()
+{
+#if defined(_MSC_VER) && defined(_DEBUG)
+    _CrtSetAllocHook(AllocationHook);
+    gMallocCountAvailable = true;
+#elif defined(__GLIBC__)
+    gMallocCountAvailable = true;
+#endif
+
+    bool passed = true;
+
+    passed &= BenchmarkSolver();
+    passed &= BenchmarkEvaluators();
+    passed &= CheckUniformAccuracy();
+    passed &= BenchmarkAllocations();
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <QVector3D>
+
+namespace BSplineCurves3D
+{
+    // Arc length of Bezier curves by adaptive Gauss-Legendre quadrature of the speed |P'(t)|.
+    // An interval is split in halves until the halves agree with the whole within the error bound.
+    class ArcLength
+    {
+    private:
+        ArcLength();
+
+    public:
+        // Length of the Bezier curve given by "count" control points on [t0, t1]. "tolerance" is relative to the length.
+        static float Compute(const QVector3D* points, int count, float t0, float t1, float tolerance);
+
+        // Speed |P'(t)| of the Bezier curve given by "count" control points
+        static float Speed(const QVector3D* points, int count, float t);
+
+        static constexpr int MAX_DEGREE = 15;
+        static constexpr int MAX_DEPTH = 16;
+
+    private:
+        struct Hodograph {
+            QVector3D points[MAX_DEGREE];
+            int degree;
+        };
+
+        static Hodograph CreateHodograph(const QVector3D* points, int count);
+        static float Speed(const Hodograph& hodograph, float t);
+        static float GaussLegendre(const Hodograph& hodograph, float a, float b);
+        static float Integrate(const Hodograph& hodograph, float a, float b, float whole, float tolerance, int depth);
+    };
+}
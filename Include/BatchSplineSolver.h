@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QVector>
+#include <QVector3D>
+
+namespace BSplineCurves3D
+{
+    // Solves the control point systems of many splines at once. Open splines are packed in groups of LANES
+    // into structure-of-arrays buffers, so that every row of the Thomas algorithm is a contiguous loop over
+    // curves and coordinates that the compiler vectorizes. Groups and closed splines are solved in parallel.
+    class BatchSplineSolver
+    {
+    private:
+        BatchSplineSolver();
+
+    public:
+        struct System {
+            QVector<QVector3D> knots;
+            bool closed;
+            QVector<QVector3D> solution;
+        };
+
+        static void Solve(QVector<System>& systems);
+
+        static constexpr int LANES = 8;
+
+    private:
+        static void SolveGroup(QVector<System>& systems, const int* indices, int count);
+        static void SolveClosed(System& system);
+    };
+}
@@ -1,15 +1,19 @@
 #pragma once
 
+#include "BufferArena.h"
 #include "Curve.h"
-#include "Point.h"
 
 #include <QObject>
-#include <QOpenGLBuffer>
 #include <QOpenGLFunctions>
 #include <QOpenGLVertexArrayObject>
+#include <QSharedPointer>
 
 namespace BSplineCurves3D
 {
+    struct TessellationChannel;
+    struct TessellationMesh;
+    struct TessellationJob;
+
     class Bezier : public Curve, protected QOpenGLFunctions
     {
         Q_OBJECT
@@ -24,20 +28,36 @@ namespace BSplineCurves3D
             Dirty,
         };
 
-        void AddControlPoint(ControlPoint* controlPoint);
-        void RemoveControlPoint(ControlPoint* controlPoint);
+        // Adaptive tessellation subdivides a tick interval until the midpoint is closer than chordTolerance to the chord
+        // and the tangents at its ends differ less than angleTolerance (degrees). Otherwise mTickCount uniform ticks are used.
+        // Packed vertices are 12 bytes instead of 24, see PackedVertex.
+        struct Tessellation {
+            bool adaptive = true;
+            float chordTolerance = 0.005f;
+            float angleTolerance = 5.0f;
+            bool packedVertices = false;
+        };
+
+        // Control points are plain positions, setting the same number of points again does not allocate.
+        // The patch only becomes dirty if a control point moves farther than the control point tolerance, returns whether it did.
+        bool SetControlPoints(const QVector3D* points, int count);
+        const QVector<QVector3D>& GetControlPoints() const;
 
-        void InsertControlPoint(int index, ControlPoint* controlPoint);
-        void RemoveControlPoint(int index);
-        void RemoveAllControlPoints();
+        // Tube frames at the start and the end knot, set by Spline so that neighbouring patches meet.
+        // Null normals are derived from the tangents.
+        void SetFrameNormals(const QVector3D& startNormal, const QVector3D& endNormal);
+        const QVector3D& GetStartNormal() const;
+        const QVector3D& GetEndNormal() const;
 
-        const QList<ControlPoint*>& GetControlPoints() const;
-        QVector<QVector3D> GetControlPointPositions();
-        ControlPoint* GetClosestControlPointToRay(const QVector3D& rayOrigin, const QVector3D& rayDirection, float maxDistance = 0.5f);
+        float GetControlPointTolerance() const;
+        void SetControlPointTolerance(float newControlPointTolerance);
+
+        // Index of the control point closest to the ray, -1 if none is closer than maxDistance
+        int GetClosestControlPointToRay(const QVector3D& rayOrigin, const QVector3D& rayDirection, float maxDistance = 0.5f);
 
         int GetDegree() const;
-        float Factorial(int n) const;
-        float Choose(int n, int k) const;
+        static float Factorial(int n);
+        static float Choose(int n, int k);
 
         // Curve interface
         virtual void Update() override;
@@ -47,9 +67,32 @@ namespace BSplineCurves3D
         virtual void Translate(const QVector3D& translation) override;
         virtual float Length() override;
 
-        void GenerateVertices();
+        // Evaluates positions (and derivatives if the buffers are given) at "count" parameters into structure-of-arrays buffers
+        void ValuesAt(const float* t, int count, float* x, float* y, float* z, float* dx = nullptr, float* dy = nullptr, float* dz = nullptr) const;
+
+        // Same as ValuesAt for the uniform ticks t = i / segments, i = 0, ..., segments
+        void ValuesAtUniformTicks(int segments, float* x, float* y, float* z, float* dx = nullptr, float* dy = nullptr, float* dz = nullptr) const;
+
+        // Same as above for the Bezier curve given by "pointCount" control points, used on tessellation snapshots
+        static void ValuesAt(const QVector3D* points, int pointCount, const float* t, int count, float* x, float* y, float* z, float* dx = nullptr, float* dy = nullptr, float* dz = nullptr);
+        static void ValuesAtUniformTicks(const QVector3D* points, int pointCount, int segments, float* x, float* y, float* z, float* dx = nullptr, float* dy = nullptr, float* dz = nullptr);
+
+        // Submits a snapshot of the patch to the TessellationScheduler, see TessellationScheduler::Priority
+        void GenerateVertices(int priority = 0);
+
+        // Snapshot of the patch at the given level of detail, without generation and priority
+        TessellationJob CreateTessellationJob(int levelOfDetail) const;
         void InitializeOpenGLStuff();
         void UpdateOpenGLStuff();
+
+        // Takes the finished tessellation without uploading it, for curves that draw all patches as one mesh.
+        // Returns false if there is none. The patch keeps the mesh until ReleaseMesh or the next TakeMesh.
+        bool TakeMesh();
+        const TessellationMesh* GetMesh() const;
+        void ReleaseMesh();
+
+        // Copies the kept mesh out of a mapped mesh cache file, see MeshCache
+        void DetachMesh();
         void Render();
 
         int GetSectorCount() const;
@@ -64,19 +107,75 @@ namespace BSplineCurves3D
         bool GetInitialized() const;
         void SetInitialized(bool newInitialized);
 
+        const Tessellation& GetTessellation() const;
+        void SetTessellation(const Tessellation& newTessellation);
+
+        // Relative error bound of the cached arc length
+        float GetLengthTolerance() const;
+        void SetLengthTolerance(float newLengthTolerance);
+
+        // Number of vertices of the last uploaded tessellation
+        int GetVertexCount() const;
+
+        // GPU memory of the last uploaded tessellation and of the same tessellation as unshared quads
+        qint64 GetMeshBytes() const;
+        qint64 GetUnindexedMeshBytes() const;
+
+        int GetTriangleCount() const;
+
+        // Estimated triangle count of the last uploaded tessellation at level of detail 0
+        qint64 GetFullDetailTriangleCount() const;
+
+        // 0 is the full detail, every level halves the sector and tick counts
+        int GetLevelOfDetail() const;
+        void SetLevelOfDetail(int newLevelOfDetail);
+
+        // Whether the uploaded mesh matches the current geometry, it may still be at another level of detail
+        bool GetMeshValid() const;
+
+        // Vertex format of the last uploaded tessellation, packed positions decode to origin + scale * position
+        bool GetPackedVertices() const;
+        const QVector3D& GetPackedOrigin() const;
+        float GetPackedScale() const;
+
+        static constexpr int MAX_SUBDIVISION_DEPTH = 8;
+        static constexpr int MIN_LEVEL_OF_DETAIL_COUNT = 8; // Sectors and ticks
+
+    private:
+        // Points the vertex array at the current ranges, they move when the BufferArena is defragmented
+        void ConfigureVertexArray();
+
     private:
-        QList<ControlPoint*> mControlPoints;
+        QVector<QVector3D> mControlPoints;
         float mLength;
+        float mLengthTolerance;
+        float mControlPointTolerance;
         int mTickCount;
         int mSectorCount;
         float mRadius;
+        QVector3D mStartNormal;
+        QVector3D mEndNormal;
+        Tessellation mTessellation;
+        int mVertexCount;
+        int mIndexCount;
+        int mUploadedVertexCount;
+        int mUploadedIndexCount;
+        bool mPackedVertices;
+        QVector3D mPackedOrigin;
+        float mPackedScale;
+        int mLevelOfDetail;
+        int mSubmittedLevelOfDetail;
+        int mMeshLevelOfDetail;
+        bool mMeshValid;
+        TessellationMesh* mMesh;
 
         QOpenGLVertexArrayObject mVertexArray;
-        QOpenGLBuffer mVertexBuffer;
-        QOpenGLBuffer mNormalBuffer;
+        BufferArena::Allocation* mVertexAllocation; // Packed vertices or positions followed by normals
+        BufferArena::Allocation* mIndexAllocation;
+        quint64 mVertexAllocationGeneration;
+        quint64 mIndexAllocationGeneration;
 
-        QVector<QVector3D> mVertices;
-        QVector<QVector3D> mNormals;
+        QSharedPointer<TessellationChannel> mTessellationChannel;
 
         VertexGenerationStatus mVertexGenerationStatus;
 
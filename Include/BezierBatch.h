@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QVector3D>
+
+namespace BSplineCurves3D
+{
+    // Evaluates cubic Bezier curves at many parameters at once. Results are written into caller-provided
+    // structure-of-arrays buffers. The implementation is chosen at runtime: AVX2 (8 parameters per instruction),
+    // SSE (4 parameters per instruction) or a scalar fallback.
+    class BezierBatch
+    {
+    private:
+        BezierBatch();
+
+    public:
+        enum class InstructionSet {
+            Scalar,
+            SSE,
+            AVX2
+        };
+
+        // "points" holds the 4 control points. Derivative buffers (dx, dy, dz) may be null.
+        static void EvaluateCubic(const QVector3D* points, const float* t, int count, float* x, float* y, float* z, float* dx = nullptr, float* dy = nullptr, float* dz = nullptr);
+
+        // Samples t = i / segments for i = 0, ..., segments (segments + 1 values) by forward differencing. SIMD lanes hold
+        // consecutive samples and step by the register width. Every lane is re-anchored with a direct evaluation after
+        // REANCHOR_INTERVAL steps, which bounds the accumulated float error.
+        static void EvaluateCubicUniform(const QVector3D* points, int segments, float* x, float* y, float* z, float* dx = nullptr, float* dy = nullptr, float* dz = nullptr);
+
+        static InstructionSet GetInstructionSet();
+        static const char* GetInstructionSetName();
+
+        static constexpr int REANCHOR_INTERVAL = 16;
+
+    private:
+        struct Coefficients {
+            float a[3];
+            float b[3];
+            float c[3];
+            float d[3];
+        };
+
+        static Coefficients PowerBasis(const QVector3D* points);
+        static void EvaluateScalar(const Coefficients& coefficients, const float* t, int begin, int end, float* const* values, float* const* derivatives);
+        static int EvaluateSSE(const Coefficients& coefficients, const float* t, int count, float* const* values, float* const* derivatives);
+        static int EvaluateAVX2(const Coefficients& coefficients, const float* t, int count, float* const* values, float* const* derivatives);
+        static void ForwardDifferenceScalar(const Coefficients& coefficients, int segments, int begin, float* const* values, float* const* derivatives);
+        static int ForwardDifferenceSSE(const Coefficients& coefficients, int segments, float* const* values, float* const* derivatives);
+        static int ForwardDifferenceAVX2(const Coefficients& coefficients, int segments, float* const* values, float* const* derivatives);
+        static InstructionSet DetectInstructionSet();
+    };
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <QVector3D>
+
+#include <array>
+
+namespace BSplineCurves3D
+{
+    // Evaluates Bezier curves of a fixed degree with binomial coefficients computed at compile time.
+    // The Bernstein polynomials are evaluated in Horner form, so no factorials and no pow calls are needed.
+    template<int Degree>
+    class BezierEvaluator
+    {
+    public:
+        static QVector3D ValueAt(const QVector3D* points, float t)
+        {
+            const float s = 1.0f - t;
+            float power = 1.0f;
+            QVector3D value = points[0] * s;
+
+            for (int i = 1; i < Degree; ++i)
+            {
+                power *= t;
+                value = (value + BINOMIALS[i] * power * points[i]) * s;
+            }
+
+            return value + power * t * points[Degree];
+        }
+
+        static QVector3D DerivativeAt(const QVector3D* points, float t)
+        {
+            QVector3D differences[Degree];
+
+            for (int i = 0; i < Degree; ++i)
+                differences[i] = points[i + 1] - points[i];
+
+            return Degree * BezierEvaluator<Degree - 1>::ValueAt(differences, t);
+        }
+
+    private:
+        static constexpr std::array<float, Degree + 1> Binomials()
+        {
+            std::array<float, Degree + 1> binomials {};
+            binomials[0] = 1.0f;
+
+            for (int i = 1; i <= Degree; ++i)
+                binomials[i] = binomials[i - 1] * (Degree - i + 1) / i;
+
+            return binomials;
+        }
+
+        static constexpr std::array<float, Degree + 1> BINOMIALS = Binomials();
+    };
+
+    typedef BezierEvaluator<3> CubicBezierEvaluator;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QList>
+#include <QMap>
+#include <QOpenGLBuffer>
+#include <QOpenGLExtraFunctions>
+
+namespace BSplineCurves3D
+{
+    // Large shared OpenGL buffers of which the pipe meshes get exactly sized ranges, instead of a buffer each.
+    // A pool is a list of chunks, each with an offset ordered free list whose neighbouring blocks are merged on release.
+    // Ranges are placed first fit, a range larger than CHUNK_SIZE gets a chunk of its own. Defragment packs all ranges
+    // of a pool into new chunks on the GPU. Owners notice moved ranges by their generation and update their vertex arrays.
+    class BufferArena : protected QOpenGLExtraFunctions
+    {
+    private:
+        BufferArena();
+
+        struct Chunk;
+
+    public:
+        static BufferArena* Instance();
+
+        enum class Pool {
+            Vertex = 0,
+            Index = 1,
+        };
+
+        struct Allocation {
+            Pool pool;
+            Chunk* chunk;
+            QOpenGLBuffer* buffer;
+            qint64 offset;
+            qint64 size;
+            quint64 generation; // Incremented whenever the range moves
+        };
+
+        // Range of at least "size" bytes. Buffers are typeless, index ranges are bound to GL_ELEMENT_ARRAY_BUFFER by id.
+        Allocation* Allocate(Pool pool, qint64 size);
+
+        // Keeps "allocation" if it is large enough and at most twice as large as needed, its contents are lost otherwise
+        Allocation* Reallocate(Allocation* allocation, Pool pool, qint64 size);
+
+        // Does not call OpenGL, so it is safe in destructors. Empty chunks are released by the next Defragment.
+        void Free(Allocation* allocation);
+
+        // "offset" is relative to the start of the range. Goes through GL_ARRAY_BUFFER, a bound vertex array is not changed.
+        void Write(Allocation* allocation, qint64 offset, const void* data, qint64 size);
+
+        // Releases empty chunks and packs a pool once half of it plus a chunk is free, or always if "force" is set.
+        // Returns the number of bytes moved.
+        qint64 Defragment(bool force = false);
+
+        qint64 GetReservedBytes() const;
+        qint64 GetUsedBytes() const;
+        int GetChunkCount() const;
+        int GetAllocationCount() const;
+
+        // Share of the free bytes that are not part of the largest free block of their chunk
+        float GetFragmentation() const;
+
+        static constexpr qint64 CHUNK_SIZE = 32 * 1024 * 1024;
+        static constexpr qint64 ALIGNMENT = 16;
+
+    private:
+        struct Chunk {
+            QOpenGLBuffer buffer;
+            qint64 size;
+            qint64 used;
+            QMap<qint64, qint64> freeBlocks; // Offset to size
+            QList<Allocation*> allocations;
+        };
+
+        // Places "size" bytes into an existing chunk of "chunks" or a new one
+        Chunk* Place(QList<Chunk*>& chunks, qint64 size, qint64& offset);
+        bool PlaceInChunk(Chunk* chunk, qint64 size, qint64& offset);
+        Chunk* CreateChunk(qint64 size);
+        void ReleaseRange(Chunk* chunk, qint64 offset, qint64 size);
+        bool IsDefragmentationRequired(const QList<Chunk*>& chunks) const;
+
+    private:
+        QList<Chunk*> mChunks[2];
+        bool mInitialized;
+    };
+}
@@ -21,8 +21,13 @@ namespace BSplineCurves3D
         virtual void Translate(const QVector3D& translation) = 0;
         virtual float Length() = 0;
 
+        // Sets the dirty flag and increments the generation. Caches remember the generation they were built at,
+        // generations start at 1 so that 0 can mean "never built".
+        void MarkDirty();
+
         DEFINE_MEMBER(bool, Selected);
         DEFINE_MEMBER(bool, Dirty);
         DEFINE_MEMBER(Material, Material);
+        DEFINE_MEMBER_CONST(quint64, Generation);
     };
 }
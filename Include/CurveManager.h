@@ -24,6 +24,9 @@ namespace BSplineCurves3D
         void RemoveAllCurves();
         void AddCurves(QList<Spline*> curves);
 
+        // Solves the control points of all given dirty curves in one batched, parallel pass
+        void UpdateCurves(const QList<Spline*>& curves);
+
         Spline* SelectCurve(const QVector3D& rayOrigin, const QVector3D& rayDirection, float maxDistance = 0.5f);
         ControlPoint* SelectKnotPoint(const QVector3D& rayOrigin, const QVector3D& rayDirection, float maxDistance = 0.5f);
 
@@ -39,6 +42,21 @@ namespace BSplineCurves3D
         int GetGlobalPipeSectorCount() const;
         void SetGlobalPipeSectorCount(int newGlobalPipeSectorCount);
 
+        // Applied to all current and future curves
+        const Bezier::Tessellation& GetGlobalTessellation() const;
+        void SetGlobalTessellation(const Bezier::Tessellation& newGlobalTessellation);
+
+        // Imports and exports keep a MeshCache next to the curve file
+        bool GetMeshCache() const;
+        void SetMeshCache(bool newMeshCache);
+
+        // Total vertex count of all pipes
+        int GetVertexCount() const;
+
+        qint64 GetLastBatchKnotCount() const;
+        float GetLastBatchTime() const;
+        float GetLastBatchKnotsPerSecond() const;
+
     signals:
         void SelectedCurveChanged(Spline* curve);
         void SelectedKnotPointChanged(KnotPoint* point);
@@ -49,5 +67,10 @@ namespace BSplineCurves3D
         KnotPoint* mSelectedPoint;
         float mGlobalPipeRadius;
         int mGlobalPipeSectorCount;
+        Bezier::Tessellation mGlobalTessellation;
+        bool mMeshCache;
+
+        qint64 mLastBatchKnotCount;
+        float mLastBatchTime; // ms
     };
 }
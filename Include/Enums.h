@@ -13,10 +13,16 @@ enum class Action {
     UpdateKnotPointPositionFromGui,
     UpdateRenderPaths,
     UpdateRenderPipes,
+    UpdateLevelOfDetail,
+    UpdateCurveMeshes,
+    UpdateMeshCache,
     UpdateSelectedCurvePipeRadius,
     UpdateSelectedCurvePipeSectorCount,
+    UpdateSelectedCurveClosed,
     UpdateGlobalPipeRadius,
     UpdateGlobalPipeSectorCount,
+    UpdateGlobalTessellation,
+    DefragmentBufferArena,
     RemoveSelectedCurve,
     RemoveSelectedKnotPoint,
     ClearScene,
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QHash>
+#include <QMutex>
+#include <QPair>
+#include <QSharedPointer>
+#include <QVector>
+
+#include <list>
+
+namespace BSplineCurves3D
+{
+    // Process-wide cache of the factorizations of the 1-4-1 spline system keyed by the system size and periodicity.
+    // Least recently used factorizations are evicted once the memory capacity is exceeded.
+    class FactorizationCache
+    {
+    private:
+        FactorizationCache();
+
+    public:
+        static FactorizationCache* Instance();
+
+        QSharedPointer<const QVector<float>> Get(int size, bool cyclic = false);
+        void Clear();
+
+        qint64 GetMemoryCapacity() const;
+        void SetMemoryCapacity(qint64 newMemoryCapacity);
+
+        qint64 GetMemoryUsage() const;
+        quint64 GetHitCount() const;
+        quint64 GetMissCount() const;
+
+    private:
+        void Evict();
+
+        typedef QPair<int, bool> Key;
+
+        struct Entry {
+            QSharedPointer<const QVector<float>> factorization;
+            std::list<Key>::iterator usage;
+        };
+
+        mutable QMutex mMutex;
+        QHash<Key, Entry> mEntries;
+        std::list<Key> mUsage; // Most recently used key first
+
+        qint64 mMemoryCapacity;
+        qint64 mMemoryUsage;
+        quint64 mHitCount;
+        quint64 mMissCount;
+    };
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "Spline.h"
+#include "TessellationScheduler.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QString>
+#include <QVector>
+#include <QWeakPointer>
+
+namespace BSplineCurves3D
+{
+    // Binary cache next to a curve file ("<file>.meshcache") with the solved spline control points of all curves
+    // and the full detail meshes of all patches. It is only used while the SHA-256 of the curve file matches the
+    // one in its header. Loading maps the file, the meshes are handed to the TessellationCache as arrays pointing
+    // into the mapping, so their uploads read straight from the mapped pages. Each of these meshes holds on to the
+    // file, it is unmapped and closed once TessellationCache::ClearMapped and the patches have dropped the last one.
+    //
+    // Native byte order, every array aligned to ALIGNMENT bytes:
+    //   Header
+    //   CurveRecord[curveCount] -> QVector3D[pointCount]
+    //   MeshRecord[meshCount]   -> QVector3D[controlPointCount], QVector3D[vertexCount] twice (vertices, normals),
+    //                              quint32[indexCount], PackedVertex[packedVertexCount]
+    class MeshCache
+    {
+    private:
+        MeshCache();
+
+    public:
+        static QString GetPath(const QString& curveFile);
+
+        // Restores the spline control points of "curves", just loaded from "curveFile", and registers the meshes.
+        // Returns false and leaves the curves untouched if there is no valid cache.
+        static bool Load(const QString& curveFile, const QList<Spline*>& curves);
+
+        // Writes the cache of "curveFile" in the background. The curves are only read here, the meshes missing from
+        // the TessellationCache are tessellated at full detail by the worker. Mapped meshes are copied and the
+        // mappings released first, an open mapping of the target would keep it from being replaced on Windows.
+        // Nothing is written while a mesh the curves cannot reach still holds the mapping.
+        static void Save(const QString& curveFile, const QList<Spline*>& curves);
+
+        static constexpr quint32 VERSION = 2;
+        static constexpr int ALIGNMENT = 16;
+
+    private:
+        static constexpr char MAGIC[] = "BSPLMESH"; // Without the terminating zero
+
+        struct Header {
+            char magic[8];
+            quint32 version;
+            quint32 curveCount;
+            quint32 meshCount;
+            quint32 reserved;
+            char hash[32];
+        };
+
+        struct CurveRecord {
+            quint64 pointOffset;
+            quint32 pointCount;
+            quint32 reserved;
+        };
+
+        enum MeshFlag {
+            Adaptive = 1,
+            PackedVertices = 2,
+            Packed = 4,
+        };
+
+        // The key of the mesh in the TessellationCache followed by the mesh
+        struct MeshRecord {
+            quint64 controlPointOffset;
+            quint64 vertexOffset;
+            quint64 normalOffset;
+            quint64 indexOffset;
+            quint64 packedVertexOffset;
+            quint32 controlPointCount;
+            quint32 vertexCount;
+            quint32 indexCount;
+            quint32 packedVertexCount;
+            quint32 tickCount;
+            quint32 sectorCount;
+            float radius;
+            float startNormal[3];
+            float endNormal[3];
+            float chordTolerance;
+            float angleTolerance;
+            quint32 flags;
+            quint32 meshSectorCount;
+            qint32 endRingShift;
+            float origin[3];
+            float scale;
+        };
+
+        struct Entry {
+            TessellationJob job;
+            TessellationMesh mesh;
+            bool cached;
+        };
+
+        // Runs on a worker thread, "points" holds the spline control points of each curve or nothing
+        static void Write(const QString& path, const QByteArray& hash, const QVector<QVector<QVector3D>>& points, QVector<Entry> entries);
+
+        static QByteArray Hash(const QString& curveFile);
+        static quint64 Align(quint64 offset);
+
+        // Every mapped cache file, alive while any mesh still points into it
+        static QList<QWeakPointer<QFile>>& GetMappings();
+        static bool IsMapped(const QString& path);
+    };
+}
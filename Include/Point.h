@@ -5,6 +5,8 @@
 
 namespace BSplineCurves3D
 {
+    class Curve;
+
     class Point : public QObject
     {
         Q_OBJECT
@@ -19,9 +21,19 @@ namespace BSplineCurves3D
         const QVector3D& GetPosition() const;
         void SetPosition(const QVector3D& newPosition);
 
+        // The curve notified when the position changes, set by the curve owning the point
+        Curve* GetOwner() const;
+        void SetOwner(Curve* newOwner);
+
+        // Incremented whenever the position changes. Starts at 1 like the curve generation, so a fresh point never
+        // matches a generation of 0 that a consumer has not recorded yet.
+        quint64 GetGeneration() const;
+
     private:
         bool mSelected;
         QVector3D mPosition;
+        Curve* mOwner;
+        quint64 mGeneration;
     };
 
     typedef Point ControlPoint;
@@ -32,6 +32,33 @@ namespace BSplineCurves3D
         bool GetRenderPaths() const;
         bool GetRenderPipes() const;
 
+        // Number of patches whose vertex generation was started during the last frame
+        int GetRetessellatedPatchCount() const;
+
+        // Pipe mesh memory drawn during the last frame, indexed and as it would be with unshared quads
+        qint64 GetMeshBytes() const;
+        qint64 GetUnindexedMeshBytes() const;
+
+        // Screen-space level of detail of the pipes, see SelectLevelOfDetail
+        bool GetLevelOfDetail() const;
+        void SetLevelOfDetail(bool newLevelOfDetail);
+
+        // Pipe triangles drawn during the last frame, and about as many as would have been drawn at full detail
+        qint64 GetTriangleCount() const;
+        qint64 GetFullDetailTriangleCount() const;
+
+        // Each curve is drawn as one continuous tube with a single draw call, see Spline::UpdateOpenGLStuff
+        bool GetCurveMeshes() const;
+        void SetCurveMeshes(bool newCurveMeshes);
+
+        // Pipe draw calls during the last frame
+        int GetDrawCallCount() const;
+
+        // Projected patch radius (fraction of the half screen height) below which level i + 1 is used
+        static constexpr int LEVEL_OF_DETAIL_COUNT = 4;
+        static constexpr float LEVEL_OF_DETAIL_THRESHOLDS[LEVEL_OF_DETAIL_COUNT - 1] = { 0.25f, 0.1f, 0.04f };
+        static constexpr float LEVEL_OF_DETAIL_HYSTERESIS = 0.2f;
+
     private slots:
         void RenderModels(float ifps);
         void RenderKnotPoints(float ifps);
@@ -40,6 +67,14 @@ namespace BSplineCurves3D
 
         void RenderUsingDumbShader(float ifps, Spline* curve, Bezier* patch);
         void RenderUsingSmartShader(float ifps, Spline* curve, Bezier* patch);
+        void RenderCurveUsingSmartShader(float ifps, Spline* curve);
+
+    private:
+        // Conservative frustum test of the control point bounding box
+        bool IsVisible(Bezier* patch) const;
+
+        // Level of detail of the patch from its projected size, with hysteresis around the thresholds
+        int SelectLevelOfDetail(Bezier* patch) const;
 
     private:
         QMap<Model::Type, ModelData*> mTypeToModelData;
@@ -64,5 +99,16 @@ namespace BSplineCurves3D
 
         bool mRenderPaths;
         bool mRenderPipes;
+
+        int mRetessellatedPatchCount;
+        qint64 mMeshBytes;
+        qint64 mUnindexedMeshBytes;
+
+        bool mLevelOfDetail;
+        qint64 mTriangleCount;
+        qint64 mFullDetailTriangleCount;
+
+        bool mCurveMeshes;
+        int mDrawCallCount;
     };
 }
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <QVector3D>
+#include <QVector>
+
+namespace BSplineCurves3D
+{
+    // Unit circle tables of the pipe sectors, one per sector count and shared by all patches and jobs.
+    // Rings are generated as center + radius * (cos * normal + sin * binormal) with the table, 8 sectors per
+    // instruction on AVX2, 4 on SSE, see BezierBatch::GetInstructionSet.
+    class SectorTable
+    {
+    private:
+        SectorTable();
+
+    public:
+        // cos and sin of i * 2 * pi / sectorCount for i = 0, ..., sectorCount, the last entry closes the circle.
+        // cos3 and sin3 repeat every value three times to line up with the x, y, z of QVector3D arrays.
+        struct Table {
+            int sectorCount;
+            QVector<float> cos;
+            QVector<float> sin;
+            QVector<float> cos3;
+            QVector<float> sin3;
+        };
+
+        // Built on first use, never freed, safe to call from any thread
+        static const Table& Get(int sectorCount);
+
+        // Writes the sectorCount vertices and normals of one ring
+        static void GenerateRing(const Table& table, const QVector3D& center, const QVector3D& normal, const QVector3D& binormal, float radius, QVector3D* vertices, QVector3D* normals);
+
+    private:
+        static void GenerateRingScalar(const Table& table, int begin, const float* center, const float* normal, const float* binormal, float radius, float* vertices, float* normals);
+        static int GenerateRingSSE(const Table& table, const float* center, const float* normal, const float* binormal, float radius, float* vertices, float* normals);
+        static int GenerateRingAVX2(const Table& table, const float* center, const float* normal, const float* binormal, float radius, float* vertices, float* normals);
+    };
+}
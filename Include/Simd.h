@@ -0,0 +1,16 @@
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BSPLINE_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit AVX2 instructions in functions marked for it, MSVC emits them anywhere
+#if defined(BSPLINE_X86) && (defined(__GNUC__) || defined(__clang__))
+#define BSPLINE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define BSPLINE_TARGET_AVX2
+#endif
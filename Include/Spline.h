@@ -4,14 +4,16 @@
 #include "Curve.h"
 #include "Point.h"
 
+#include <QHash>
 #include <QObject>
+#include <QOpenGLFunctions>
+#include <QOpenGLVertexArrayObject>
+#include <QPair>
 #include <QVector3D>
 
-#include <Dense>
-
 namespace BSplineCurves3D
 {
-    class Spline : public Curve
+    class Spline : public Curve, protected QOpenGLFunctions
     {
         Q_OBJECT
     public:
@@ -29,6 +31,12 @@ namespace BSplineCurves3D
 
         Spline* DeepCopy();
 
+        // Batched solving, see CurveManager::UpdateCurves
+        bool IsSolveRequired() const;
+        QVector<QVector3D> GetKnotPointPositions() const;
+        void SetSplineControlPoints(const QVector<QVector3D>& splineControlPoints);
+        const QVector<QVector3D>& GetSplineControlPoints() const;
+
         // Curve interface
         void Update();
         QVector3D ValueAt(float t) const;
@@ -43,17 +51,127 @@ namespace BSplineCurves3D
         void SetSectorCount(int newSectorCount);
         void SetRadius(float newRadius);
 
+        // Arc-length parameterization. Distances are measured from the first knot, parameters are the ones of ValueAt.
+        // Lookups use a lazily built table of cumulative lengths, a binary search and one Newton step.
+        float DistanceToParameter(float distance);
+        QVector3D ValueAtDistance(float distance);
+        QVector<float> DistancesToParameters(const QVector<float>& distances);
+        QVector<QVector3D> ValuesAtDistances(const QVector<float>& distances);
+
+        static constexpr int ARC_LENGTH_TABLE_RESOLUTION = 16; // Entries per patch
+        static constexpr int MAX_PATCH_POOL_SIZE = 16;
+
+        const Bezier::Tessellation& GetTessellation() const;
+        void SetTessellation(const Bezier::Tessellation& newTessellation);
+
+        // Sum of the vertex counts of all patches
+        int GetVertexCount() const;
+
+        // Closed splines have an additional patch from the last knot to the first one and are C2 continuous there
+        bool GetClosed() const;
+        void SetClosed(bool newClosed);
+
+        // Spline control points whose change would stay below this distance are not recomputed when knots move.
+        // Skipped changes add up, a point is recomputed once the sum of its skipped changes passes the tolerance.
+        float GetIncrementalTolerance() const;
+        void SetIncrementalTolerance(float newIncrementalTolerance);
+
+        // Whole curve pipe in one vertex array, built from the meshes the patches hold (see Bezier::TakeMesh).
+        // Each patch owns a range of the buffers, only the ranges of retessellated patches are rewritten.
+        // The first ring of a patch is replaced by the last ring of the previous one, so the tube is continuous.
+        // Render draws the ranges of patches with current meshes, the others are drawn on their own meanwhile.
+        void InitializeOpenGLStuff();
+        void UpdateOpenGLStuff();
+        void Render();
+
+        // True if the buffers have a range for each patch, see GetPatchDrawn for the ranges Render draws
+        bool GetMeshValid() const;
+        bool GetPatchDrawn(int index) const;
+        int GetDrawCallCount() const;
+        int GetTriangleCount() const;
+        qint64 GetFullDetailTriangleCount() const;
+        qint64 GetMeshBytes() const;
+        qint64 GetUnindexedMeshBytes() const;
+
     private:
-        Eigen::MatrixXf CreateCoefficientMatrix();
-        QVector<QVector3D> GetSplineControlPoints();
+        void SolveSplineControlPoints();
+        void UpdateSplineControlPoints(int& firstPatch, int& lastPatch);
+        void UpdateBezierPatches(int firstPatch, int lastPatch);
+        bool UpdateBezierPatch(int index);
+        void UpdateFrameNormals(int firstPatch, int patchCount);
+        bool IsClosedLoop() const;
+        void UpdateArcLengthTable();
+        void WriteMeshIndices(int index);
+
+        struct MeshRange;
+        const MeshRange* GetPreviousMeshRange(int index) const;
+        void ConfigureVertexArray();
+        Bezier* AcquirePatch();
+        void ReleasePatch(Bezier* patch);
+        float LookupParameter(float distance) const;
 
     private:
         QList<KnotPoint*> mKnotPoints;
         QList<Bezier*> mBezierPatches;
 
+        // Knots connected by each patch and unused patches kept with their OpenGL resources
+        typedef QPair<KnotPoint*, KnotPoint*> PatchKnots;
+        QList<PatchKnots> mPatchKnots;
+        QList<Bezier*> mPatchPool;
+
+        QVector<QVector3D> mSplineControlPoints;
+        QVector<QVector3D> mKnotPositions;
+        QVector<quint64> mKnotGenerations;
+        QVector<float> mSkippedChanges; // Bound of the change each spline control point missed since it was solved
+
+        // Scratch buffers of the tridiagonal solves
+        QVector<QVector3D> mConstants;
+        QVector<QVector3D> mSolution;
+        QVector<int> mMovedKnots;
+        QVector<bool> mChangedPatches; // Of the updated patch range
+
+        QVector<float> mArcLengthTable;
+        quint64 mArcLengthTableGeneration;
+
+        float mLength;
+        quint64 mLengthGeneration;
+
         int mSectorCount;
         float mRadius;
+        float mIncrementalTolerance;
+        Bezier::Tessellation mTessellation;
+        bool mClosed;
 
         bool mPointRemovedOrAdded;
+
+        // Buffer range of a patch and the mesh it was written from
+        struct MeshRange {
+            Bezier* patch;
+            quint64 generation;
+            int vertexOffset;
+            int vertexCount;
+            int indexOffset;
+            int indexCount;
+            int sectorCount;
+            int endRingShift;
+            bool current;        // Holds the current mesh of the patch
+            bool indicesChanged; // Written once the range is current
+            bool drawn;
+        };
+
+        QOpenGLVertexArrayObject mVertexArray;
+        BufferArena::Allocation* mVertexAllocation; // Positions of all patches followed by their normals
+        BufferArena::Allocation* mIndexAllocation;
+        quint64 mVertexAllocationGeneration;
+        quint64 mIndexAllocationGeneration;
+        bool mOpenGLInitialized;
+
+        QVector<MeshRange> mMeshRanges;
+        QVector<quint32> mMeshIndices; // Scratch
+        int mMeshVertexCount;
+        int mMeshIndexCount;
+        QVector<QPair<int, int>> mDrawRanges; // Index offsets and counts of the runs Render draws
+        int mDrawnIndexCount;
+        bool mMeshValid;
     };
 }
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "TessellationScheduler.h"
+
+#include <QCache>
+#include <QHash>
+#include <QMutex>
+#include <QVector3D>
+#include <QVector>
+
+namespace BSplineCurves3D
+{
+    // Everything the mesh of a job depends on, compared bit for bit
+    struct TessellationCacheKey {
+        QVector<QVector3D> controlPoints;
+        Bezier::Tessellation tessellation;
+        int tickCount = 0;
+        int sectorCount = 0;
+        float radius = 0.0f;
+        QVector3D startNormal;
+        QVector3D endNormal;
+
+        bool operator==(const TessellationCacheKey& other) const;
+    };
+
+    size_t qHash(const TessellationCacheKey& key, size_t seed = 0);
+
+    // Finished meshes keyed by the content of their jobs, so patches with the same geometry share one tessellation,
+    // e.g. after moving a knot back, reopening a file, copying a curve or dragging the radius back and forth.
+    // The least recently used meshes are evicted once the cache grows past its byte budget. Entries share their
+    // arrays with the meshes handed out (implicit sharing), a hit does not copy vertices.
+    class TessellationCache
+    {
+    private:
+        TessellationCache();
+
+    public:
+        static TessellationCache* Instance();
+
+        // Copies the cached mesh of the job into "mesh" and returns true, safe to call from any thread
+        bool Find(const TessellationJob& job, TessellationMesh& mesh);
+        void Insert(const TessellationJob& job, const TessellationMesh& mesh);
+        void Clear();
+
+        // Meshes whose arrays live in memory mapped files, see MeshCache. They are looked up after the others,
+        // only dropped by ClearMapped and not counted against the budget. A file stays mapped while any mesh,
+        // here or handed out, still points into it.
+        void InsertMapped(const TessellationCacheKey& key, const TessellationMesh& mesh);
+        void ClearMapped();
+        qint64 GetMappedBytes() const;
+        int GetMappedEntryCount() const;
+
+        // Gives a mapped mesh arrays of its own, so that it no longer keeps its file mapped
+        static void Detach(TessellationMesh& mesh);
+
+        static TessellationCacheKey MakeKey(const TessellationJob& job);
+        static qint64 GetMeshBytes(const TessellationMesh& mesh);
+
+        qint64 GetBudget() const;
+        void SetBudget(qint64 newBudget);
+
+        qint64 GetBytes() const;
+        int GetEntryCount() const;
+        quint64 GetHitCount() const;
+        quint64 GetMissCount() const;
+
+        static constexpr qint64 DEFAULT_BUDGET = 64 * 1024 * 1024;
+
+    private:
+        static void Copy(const TessellationMesh& source, TessellationMesh& mesh);
+
+    private:
+        mutable QMutex mMutex;
+        QCache<TessellationCacheKey, TessellationMesh> mCache;
+        QHash<TessellationCacheKey, TessellationMesh> mMappedMeshes;
+        qint64 mMappedBytes;
+        quint64 mHitCount;
+        quint64 mMissCount;
+    };
+}
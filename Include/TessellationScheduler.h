@@ -0,0 +1,156 @@
+#pragma once
+
+#include "Bezier.h"
+
+#include <QAtomicInteger>
+#include <QAtomicPointer>
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QSet>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVector3D>
+#include <QVector>
+
+namespace BSplineCurves3D
+{
+    // Interleaved vertex of the packed format. The position is snorm16 relative to the patch bounds,
+    // origin + scale * position, the normal is octahedron encoded into two snorm16.
+    struct PackedVertex {
+        qint16 position[4]; // The fourth component aligns the normal to 4 bytes
+        qint16 normal[2];
+    };
+
+    // Rings of sectorCount vertices, one per tick, drawn as indexed triangles. Packed meshes
+    // use the float vertices and normals as scratch only.
+    struct TessellationMesh {
+        QVector<QVector3D> vertices;
+        QVector<QVector3D> normals;
+        QVector<quint32> indices;
+        QVector<PackedVertex> packedVertices;
+        QVector3D origin;
+        float scale = 1.0f;
+        bool packed = false;
+        int sectorCount = 0;
+        int endRingShift = 0; // Vertex i of the last ring is vertex (i - endRingShift) mod sectorCount of the next patch's first ring
+        quint64 generation = 0;
+        QSharedPointer<QFile> mappedFile; // Set if the arrays point into this file's mapping, see MeshCache
+    };
+
+    // Shared by a patch and its jobs. A job only ever touches the channel, never the patch, so the patch
+    // may be deleted while one of its jobs is in flight. Finished meshes are published with an atomic swap,
+    // the render thread takes them and hands the storage back as the next back buffer.
+    struct TessellationChannel {
+        TessellationChannel();
+        ~TessellationChannel();
+
+        // Generation of the latest request, 0 cancels every job of the channel
+        QAtomicInteger<quint64> generation;
+        QAtomicPointer<TessellationMesh> published;
+        QAtomicPointer<TessellationMesh> spare;
+
+        TessellationMesh* AcquireMesh();
+        void ReleaseMesh(TessellationMesh* mesh);
+
+        // Replaces the published mesh, a mesh that was never taken is recycled
+        void Publish(TessellationMesh* mesh);
+
+        // Published mesh or nullptr, the caller owns it
+        TessellationMesh* Take();
+
+        // Copies a published mesh out of a mapped mesh cache file, see MeshCache
+        void DetachPublished();
+    };
+
+    // Snapshot of everything a patch tessellation needs
+    struct TessellationJob {
+        QSharedPointer<TessellationChannel> channel;
+        QVector<QVector3D> controlPoints;
+        Bezier::Tessellation tessellation;
+        int tickCount = 0;
+        int sectorCount = 0;
+        float radius = 0.0f;
+        QVector3D startNormal; // Frames at the knots, carried along the curve by Spline. Null derives them from the tangent.
+        QVector3D endNormal;
+        quint64 generation = 0;
+        int priority = 0;
+    };
+
+    class TessellationScheduler
+    {
+    private:
+        TessellationScheduler();
+
+    public:
+        static TessellationScheduler* Instance();
+
+        enum Priority {
+            Hidden = 0,
+            Visible = 1,
+            Selected = 2,
+        };
+
+        // A queued job of the same channel is superseded by the new one
+        void Submit(const TessellationJob& job);
+
+        // Drops the queued jobs of the channel, a running job notices the cancellation through the channel generation
+        void Cancel(const QSharedPointer<TessellationChannel>& channel);
+
+        // Every live channel registers itself, so published meshes nobody has taken yet can be reached
+        void RegisterChannel(TessellationChannel* channel);
+        void UnregisterChannel(TessellationChannel* channel);
+        void DetachPublishedMeshes();
+
+        int GetQueuedJobCount() const;
+        quint64 GetCompletedJobCount() const;
+        quint64 GetCancelledJobCount() const;
+
+        // Builds the pipe of the job into "mesh". Returns false if the job was cancelled meanwhile.
+        static bool Tessellate(const TessellationJob& job, TessellationMesh& mesh);
+
+        // Quantizes the float vertices and normals of "mesh" into its packed vertices
+        static void Pack(TessellationMesh& mesh);
+
+        // Carries "normal" from the start to the end of the Bezier curve along rotation minimizing frames,
+        // sampled at CARRY_SEGMENTS uniform ticks. A null normal starts from the reference normal.
+        static QVector3D CarryNormal(const QVector3D* points, int pointCount, const QVector3D& normal);
+
+        // "normal" projected onto the normal plane of "tangent", the reference normal if that leaves too little of it
+        static QVector3D ProjectNormal(const QVector3D& normal, const QVector3D& tangent);
+
+        static constexpr int CANCELLATION_CHECK_INTERVAL = 16; // ticks
+        static constexpr int CARRY_SEGMENTS = 16;
+
+    private:
+        void RunNext();
+
+        // Rotation minimizing frames at the samples, from "startNormal" and twisted onto "endNormal" modulo a sector.
+        // Neighbouring patches share the normal of their knot, so their rings meet. Returns the end ring shift in sectors.
+        static int ComputeFrames(const float* x, const float* y, const float* z, const float* dx, const float* dy, const float* dz, int count, int sectorCount, const QVector3D& startNormal, const QVector3D& endNormal, QVector<QVector3D>& tangents, QVector<QVector3D>& normals);
+        static void ComputeTangents(const float* x, const float* y, const float* z, const float* dx, const float* dy, const float* dz, int count, QVector3D* tangents);
+
+        // Double reflection of the frame at sample i onto sample i + 1
+        static QVector3D Reflect(const float* x, const float* y, const float* z, const QVector3D* tangents, int i, const QVector3D& normal);
+
+        static QVector3D ReferenceNormal(const QVector3D& tangent);
+        static qint16 Quantize(float value);
+
+        static QVector<float> GenerateAdaptiveTicks(const TessellationJob& job);
+        static void Subdivide(const TessellationJob& job, float t0, const QVector3D& value0, const QVector3D& tangent0, float t1, const QVector3D& value1, const QVector3D& tangent1, int depth, QVector<float>& ticks);
+        static void ValueAndTangentAt(const TessellationJob& job, float t, QVector3D& value, QVector3D& tangent);
+
+    private:
+        // Outlives the thread pool and the queue, whose jobs release their channels
+        QMutex mChannelMutex;
+        QSet<TessellationChannel*> mChannels;
+
+        QThreadPool mThreadPool;
+
+        mutable QMutex mMutex;
+        QList<TessellationJob> mQueue;
+
+        QAtomicInteger<quint64> mCompletedJobCount;
+        QAtomicInteger<quint64> mCancelledJobCount;
+    };
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QVector3D>
+
+namespace BSplineCurves3D
+{
+    class TridiagonalSolver
+    {
+    private:
+        TridiagonalSolver();
+
+    public:
+        // Solves the 1-4-1 banded system of the spline control points in O(n) using the Thomas algorithm.
+        // All three coordinates are eliminated in the same pass. "constants" and "solution" must hold "size" elements.
+        // The factorization is taken from FactorizationCache, so repeated solves of the same size only substitute.
+        static void Solve(const QVector3D* constants, QVector3D* solution, int size);
+
+        // Solves the periodic 1-4-1 system of closed splines, i.e. the system with additional 1s
+        // in the upper right and lower left corners, in O(n) using the Sherman-Morrison formula. Requires size >= 3.
+        static void SolveCyclic(const QVector3D* constants, QVector3D* solution, int size);
+
+        // Forward and back substitution with a factorization computed by Factorize.
+        static void Solve(const float* factorization, const QVector3D* constants, QVector3D* solution, int size);
+
+        // Writes the modified super-diagonal of the forward elimination of the 1-4-1 system into "factorization".
+        static void Factorize(float* factorization, int size);
+
+        // Writes the factorization of the Sherman-Morrison base system followed by its correction vector,
+        // so "factorization" must hold 2 * size elements.
+        static void FactorizeCyclic(float* factorization, int size);
+
+    private:
+        static void Factorize(float* factorization, int size, float firstDiagonal, float lastDiagonal);
+
+        static constexpr float CYCLIC_GAMMA = -4.0f;
+    };
+}
@@ -11,6 +11,7 @@
 namespace BSplineCurves3D
 {
     class Controller;
+    class FactorizationCache;
 
     class Window : public QOpenGLWindow, protected QOpenGLFunctions
     {
@@ -44,6 +45,7 @@ namespace BSplineCurves3D
         RendererManager* mRendererManager;
         CurveManager* mCurveManager;
         LightManager* mLightManager;
+        FactorizationCache* mFactorizationCache;
 
         Light* mActiveLight;
 
@@ -51,11 +53,15 @@ namespace BSplineCurves3D
 
         bool mRenderPaths;
         bool mRenderPipes;
+        bool mLevelOfDetail;
+        bool mCurveMeshes;
 
         Spline* mSelectedCurve;
         KnotPoint* mSelectedKnotPoint;
 
         float mGlobalPipeRadius;
         int mGlobalPipeSectorCount;
+        Bezier::Tessellation mGlobalTessellation;
+        bool mMeshCache;
     };
 }
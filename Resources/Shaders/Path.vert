@@ -35,6 +35,16 @@ float choose(int n, int k)
 
 vec3 value_at(float t)
 {
+    // Cubic patches in power basis, evaluated in Horner form
+    if(degree == 3)
+    {
+        vec3 a = -control_points[0] + 3 * control_points[1] - 3 * control_points[2] + control_points[3];
+        vec3 b = 3 * control_points[0] - 6 * control_points[1] + 3 * control_points[2];
+        vec3 c = -3 * control_points[0] + 3 * control_points[1];
+
+        return ((a * t + b) * t + c) * t + control_points[0];
+    }
+
     vec3 value = vec3(0, 0, 0);
 
     for(int i = 0; i <= degree; ++i)
@@ -8,10 +8,33 @@ out vec3 fs_normal;
 uniform mat4 view_matrix;
 uniform mat4 projection_matrix;
 
+// Packed vertices: snorm16 position relative to the patch bounds and octahedron encoded normal in normal.xy
+uniform bool packed_vertices;
+uniform vec3 origin;
+uniform float scale;
+
+vec3 octahedron_decode(vec2 e)
+{
+    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+
+    return normalize(n);
+}
+
 void main()
 {
-    fs_position = position;
-    fs_normal =  normal;
+    if (packed_vertices)
+    {
+        fs_position = origin + scale * position;
+        fs_normal = octahedron_decode(normal.xy);
+    }
+    else
+    {
+        fs_position = position;
+        fs_normal = normal;
+    }
 
-    gl_Position = projection_matrix * view_matrix * vec4(position, 1.0);
+    gl_Position = projection_matrix * view_matrix * vec4(fs_position, 1.0);
 }
@@ -0,0 +1,92 @@
+#include "ArcLength.h"
+#include "BezierEvaluator.h"
+
+#include <QtGlobal>
+
+BSplineCurves3D::ArcLength::ArcLength() {}
+
+float BSplineCurves3D::ArcLength::Compute(const QVector3D* points, int count, float t0, float t1, float tolerance)
+{
+    if (count < 2 || t0 >= t1)
+        return 0.0f;
+
+    Hodograph hodograph = CreateHodograph(points, count);
+    float whole = GaussLegendre(hodograph, t0, t1);
+
+    return Integrate(hodograph, t0, t1, whole, tolerance * whole, 0);
+}
+
+float BSplineCurves3D::ArcLength::Speed(const QVector3D* points, int count, float t)
+{
+    if (count < 2)
+        return 0.0f;
+
+    return Speed(CreateHodograph(points, count), t);
+}
+
+BSplineCurves3D::ArcLength::Hodograph BSplineCurves3D::ArcLength::CreateHodograph(const QVector3D* points, int count)
+{
+    // The hodograph of a degree n curve has the control points n * (P[i + 1] - P[i])
+    Hodograph hodograph;
+    hodograph.degree = qMin(count, MAX_DEGREE + 1) - 2;
+
+    for (int i = 0; i <= hodograph.degree; ++i)
+        hodograph.points[i] = (hodograph.degree + 1) * (points[i + 1] - points[i]);
+
+    return hodograph;
+}
+
+float BSplineCurves3D::ArcLength::Speed(const Hodograph& hodograph, float t)
+{
+    switch (hodograph.degree)
+    {
+    case 0:
+        return hodograph.points[0].length();
+    case 1:
+        return BezierEvaluator<1>::ValueAt(hodograph.points, t).length();
+    case 2:
+        return BezierEvaluator<2>::ValueAt(hodograph.points, t).length();
+    default:
+        break;
+    }
+
+    // de Casteljau for higher degrees
+    QVector3D points[MAX_DEGREE];
+
+    for (int i = 0; i <= hodograph.degree; ++i)
+        points[i] = hodograph.points[i];
+
+    for (int k = hodograph.degree; k > 0; --k)
+        for (int i = 0; i < k; ++i)
+            points[i] = (1 - t) * points[i] + t * points[i + 1];
+
+    return points[0].length();
+}
+
+float BSplineCurves3D::ArcLength::GaussLegendre(const Hodograph& hodograph, float a, float b)
+{
+    // 5-point rule, exact for polynomials up to degree 9
+    constexpr float NODES[5] = { 0.0f, -0.5384693101f, 0.5384693101f, -0.9061798459f, 0.9061798459f };
+    constexpr float WEIGHTS[5] = { 0.5688888889f, 0.4786286705f, 0.4786286705f, 0.2369268851f, 0.2369268851f };
+
+    float center = 0.5f * (a + b);
+    float halfWidth = 0.5f * (b - a);
+    float sum = 0.0f;
+
+    for (int i = 0; i < 5; ++i)
+        sum += WEIGHTS[i] * Speed(hodograph, center + halfWidth * NODES[i]);
+
+    return halfWidth * sum;
+}
+
+float BSplineCurves3D::ArcLength::Integrate(const Hodograph& hodograph, float a, float b, float whole, float tolerance, int depth)
+{
+    float middle = 0.5f * (a + b);
+    float left = GaussLegendre(hodograph, a, middle);
+    float right = GaussLegendre(hodograph, middle, b);
+
+    if (depth >= MAX_DEPTH || qAbs(left + right - whole) <= tolerance)
+        return left + right;
+
+    return Integrate(hodograph, a, middle, left, 0.5f * tolerance, depth + 1) + Integrate(hodograph, middle, b, right, 0.5f * tolerance, depth + 1);
+}
@@ -0,0 +1,137 @@
+#include "BatchSplineSolver.h"
+#include "FactorizationCache.h"
+#include "TridiagonalSolver.h"
+
+#include <QtConcurrent>
+
+BSplineCurves3D::BatchSplineSolver::BatchSplineSolver() {}
+
+void BSplineCurves3D::BatchSplineSolver::Solve(QVector<System>& systems)
+{
+    QVector<int> open;
+    QVector<int> closed;
+
+    for (int i = 0; i < systems.size(); ++i)
+    {
+        if (systems[i].closed)
+            closed << i;
+        else
+            open << i;
+    }
+
+    // Sorting by size keeps the padding of each group small
+    std::sort(open.begin(), open.end(), [&](int a, int b) { return systems[a].knots.size() > systems[b].knots.size(); });
+
+    struct Task {
+        int first;
+        int count;
+        bool closed;
+    };
+
+    QVector<Task> tasks;
+
+    for (int i = 0; i < open.size(); i += LANES)
+        tasks << Task { i, qMin(LANES, static_cast<int>(open.size()) - i), false };
+
+    for (int i = 0; i < closed.size(); ++i)
+        tasks << Task { i, 1, true };
+
+    QtConcurrent::blockingMap(tasks, [&](const Task& task) {
+        if (task.closed)
+            SolveClosed(systems[closed[task.first]]);
+        else
+            SolveGroup(systems, open.constData() + task.first, task.count);
+    });
+}
+
+void BSplineCurves3D::BatchSplineSolver::SolveGroup(QVector<System>& systems, const int* indices, int count)
+{
+    // The largest system comes first. Since the factorization of the 1-4-1 system of a smaller
+    // size is a prefix of the larger one, every lane can share the same multipliers.
+    int size = systems[indices[0]].knots.size() - 2;
+    auto factorization = FactorizationCache::Instance()->Get(size);
+    const float* multipliers = factorization->constData();
+
+    // Row i holds x of all lanes, then y of all lanes, then z of all lanes
+    const int stride = 3 * LANES;
+    QVector<float> values(size * stride, 0.0f);
+
+    // Back substitution multipliers are zero past the last row of a lane, which decouples the padding
+    QVector<float> backMultipliers(size * LANES, 0.0f);
+
+    for (int lane = 0; lane < count; ++lane)
+    {
+        const QVector<QVector3D>& knots = systems[indices[lane]].knots;
+        int n = knots.size();
+        int m = n - 2;
+
+        for (int i = 0; i < m; ++i)
+            for (int c = 0; c < 3; ++c)
+                values[i * stride + c * LANES + lane] = 6 * knots[i + 1][c];
+
+        for (int c = 0; c < 3; ++c)
+        {
+            values[c * LANES + lane] -= knots[0][c];
+            values[(m - 1) * stride + c * LANES + lane] -= knots[n - 1][c];
+        }
+
+        for (int i = 0; i < m - 1; ++i)
+            backMultipliers[i * LANES + lane] = multipliers[i];
+    }
+
+    float* data = values.data();
+
+    // Forward substitution
+    for (int k = 0; k < stride; ++k)
+        data[k] *= multipliers[0];
+
+    for (int i = 1; i < size; ++i)
+    {
+        float* row = data + i * stride;
+        const float* previous = row - stride;
+        const float multiplier = multipliers[i];
+
+        for (int k = 0; k < stride; ++k)
+            row[k] = (row[k] - previous[k]) * multiplier;
+    }
+
+    // Back substitution
+    for (int i = size - 2; i >= 0; --i)
+    {
+        float* row = data + i * stride;
+        const float* next = row + stride;
+        const float* rowMultipliers = backMultipliers.constData() + i * LANES;
+
+        for (int c = 0; c < 3; ++c)
+            for (int lane = 0; lane < LANES; ++lane)
+                row[c * LANES + lane] -= rowMultipliers[lane] * next[c * LANES + lane];
+    }
+
+    for (int lane = 0; lane < count; ++lane)
+    {
+        System& system = systems[indices[lane]];
+        int n = system.knots.size();
+
+        system.solution.resize(n);
+        system.solution[0] = system.knots[0];
+        system.solution[n - 1] = system.knots[n - 1];
+
+        for (int i = 0; i < n - 2; ++i)
+        {
+            const float* row = data + i * stride;
+            system.solution[i + 1] = QVector3D(row[lane], row[LANES + lane], row[2 * LANES + lane]);
+        }
+    }
+}
+
+void BSplineCurves3D::BatchSplineSolver::SolveClosed(System& system)
+{
+    int n = system.knots.size();
+    QVector<QVector3D> constants(n);
+
+    for (int i = 0; i < n; ++i)
+        constants[i] = 6 * system.knots[i];
+
+    system.solution.resize(n);
+    TridiagonalSolver::SolveCyclic(constants.constData(), system.solution.data(), n);
+}
@@ -1,110 +1,139 @@
 #include "Bezier.h"
-#include "Helper.h"
+#include "ArcLength.h"
+#include "BezierBatch.h"
+#include "BezierEvaluator.h"
+#include "TessellationCache.h"
+#include "TessellationScheduler.h"
 
-#include <QQuaternion>
-#include <QtConcurrent>
 #include <QtMath>
 
+#include <cstddef>
+
 #include <Dense>
 
 BSplineCurves3D::Bezier::Bezier(QObject* parent)
     : Curve(parent)
+    , mLength(0.0f)
+    , mLengthTolerance(1e-5f)
+    , mControlPointTolerance(1e-5f)
     , mTickCount(100)
     , mSectorCount(128)
     , mRadius(0.25f)
+    , mVertexCount(0)
+    , mIndexCount(0)
+    , mUploadedVertexCount(0)
+    , mUploadedIndexCount(0)
+    , mPackedVertices(false)
+    , mPackedScale(1.0f)
+    , mLevelOfDetail(0)
+    , mSubmittedLevelOfDetail(0)
+    , mMeshLevelOfDetail(0)
+    , mMeshValid(false)
+    , mMesh(nullptr)
+    , mVertexAllocation(nullptr)
+    , mIndexAllocation(nullptr)
+    , mVertexAllocationGeneration(0)
+    , mIndexAllocationGeneration(0)
+    , mTessellationChannel(QSharedPointer<TessellationChannel>::create())
     , mVertexGenerationStatus(VertexGenerationStatus::Dirty)
     , mInitialized(false)
-{
-    initializeOpenGLFunctions();
-}
+{}
 
 BSplineCurves3D::Bezier::~Bezier()
 {
+    // A job in flight keeps the channel alive and drops its result
+    TessellationScheduler::Instance()->Cancel(mTessellationChannel);
+    delete mMesh;
+
     mVertexArray.destroy();
-    mVertexBuffer.destroy();
-    mNormalBuffer.destroy();
+    BufferArena::Instance()->Free(mVertexAllocation);
+    BufferArena::Instance()->Free(mIndexAllocation);
 }
 
-void BSplineCurves3D::Bezier::AddControlPoint(ControlPoint* controlPoint)
+bool BSplineCurves3D::Bezier::SetControlPoints(const QVector3D* points, int count)
 {
-    mControlPoints << controlPoint;
-    controlPoint->setParent(this);
-    mDirty = true;
-}
+    // Patches whose control points move less than the tolerance keep their length and vertices. Comparing against
+    // the stored points bounds the error of skipped updates by the tolerance, even across many small moves.
+    if (mControlPoints.size() == count)
+    {
+        bool changed = false;
 
-void BSplineCurves3D::Bezier::RemoveControlPoint(ControlPoint* controlPoint)
-{
-    mControlPoints.removeAll(controlPoint);
-    controlPoint->deleteLater();
-    mDirty = true;
-}
+        for (int i = 0; i < count && !changed; ++i)
+            changed = (points[i] - mControlPoints[i]).lengthSquared() > mControlPointTolerance * mControlPointTolerance;
 
-void BSplineCurves3D::Bezier::InsertControlPoint(int index, ControlPoint* controlPoint)
-{
-    mControlPoints.insert(index, controlPoint);
-    controlPoint->setParent(this);
-    mDirty = true;
-    mVertexGenerationStatus = VertexGenerationStatus::Dirty;
-}
+        if (!changed)
+            return false;
+    }
 
-void BSplineCurves3D::Bezier::RemoveControlPoint(int index)
-{
-    ControlPoint* controlPoint = mControlPoints[index];
-    mControlPoints.removeAt(index);
-    controlPoint->setParent(nullptr);
-    controlPoint->deleteLater();
-    mDirty = true;
+    // Same sized updates reuse the storage
+    mControlPoints.resize(count);
+
+    for (int i = 0; i < count; ++i)
+        mControlPoints[i] = points[i];
+
+    MarkDirty();
     mVertexGenerationStatus = VertexGenerationStatus::Dirty;
+    mMeshValid = false;
+
+    return true;
 }
 
-void BSplineCurves3D::Bezier::RemoveAllControlPoints()
+void BSplineCurves3D::Bezier::SetFrameNormals(const QVector3D& startNormal, const QVector3D& endNormal)
 {
-    for (auto& point : mControlPoints)
-    {
-        point->deleteLater();
-    }
+    if (mStartNormal == startNormal && mEndNormal == endNormal)
+        return;
 
-    mControlPoints.clear();
+    mStartNormal = startNormal;
+    mEndNormal = endNormal;
 
-    mDirty = true;
+    MarkDirty();
     mVertexGenerationStatus = VertexGenerationStatus::Dirty;
+    mMeshValid = false;
 }
 
-const QList<BSplineCurves3D::ControlPoint*>& BSplineCurves3D::Bezier::GetControlPoints() const
+const QVector3D& BSplineCurves3D::Bezier::GetStartNormal() const
 {
-    return mControlPoints;
+    return mStartNormal;
 }
 
-QVector<QVector3D> BSplineCurves3D::Bezier::GetControlPointPositions()
+const QVector3D& BSplineCurves3D::Bezier::GetEndNormal() const
 {
-    QVector<QVector3D> positions;
-
-    for (auto& controlPoint : mControlPoints)
-        positions << controlPoint->GetPosition();
+    return mEndNormal;
+}
 
-    return positions;
+const QVector<QVector3D>& BSplineCurves3D::Bezier::GetControlPoints() const
+{
+    return mControlPoints;
 }
 
 QVector3D BSplineCurves3D::Bezier::ValueAt(float t) const
 {
+    // Spline::Update always produces cubic patches
+    if (GetDegree() == 3)
+        return CubicBezierEvaluator::ValueAt(mControlPoints.constData(), t);
+
     QVector3D value = QVector3D(0, 0, 0);
     int n = GetDegree();
 
     for (int i = 0; i <= n; i++)
-        value += Choose(n, i) * pow(t, i) * pow(1 - t, n - i) * mControlPoints[i]->GetPosition();
+        value += Choose(n, i) * pow(t, i) * pow(1 - t, n - i) * mControlPoints[i];
 
     return value;
 }
 
 QVector3D BSplineCurves3D::Bezier::TangentAt(float t) const
 {
+    // Tangents point from the end towards the start of the patch
+    if (GetDegree() == 3)
+        return -CubicBezierEvaluator::DerivativeAt(mControlPoints.constData(), t).normalized();
+
     QVector3D tangent = QVector3D(0, 0, 0);
     int order = GetDegree();
 
     for (int i = 0; i <= order - 1; i++)
     {
         float coefficient = Choose(order - 1, i) * pow(t, i) * pow(1 - t, order - 1 - i);
-        tangent += coefficient * (mControlPoints.at(i)->GetPosition() - mControlPoints.at(i + 1)->GetPosition());
+        tangent += coefficient * (mControlPoints[i] - mControlPoints[i + 1]);
     }
 
     tangent.normalize();
@@ -112,12 +141,74 @@ QVector3D BSplineCurves3D::Bezier::TangentAt(float t) const
     return tangent;
 }
 
+void BSplineCurves3D::Bezier::ValuesAt(const float* t, int count, float* x, float* y, float* z, float* dx, float* dy, float* dz) const
+{
+    ValuesAt(mControlPoints.constData(), mControlPoints.size(), t, count, x, y, z, dx, dy, dz);
+}
+
+void BSplineCurves3D::Bezier::ValuesAtUniformTicks(int segments, float* x, float* y, float* z, float* dx, float* dy, float* dz) const
+{
+    ValuesAtUniformTicks(mControlPoints.constData(), mControlPoints.size(), segments, x, y, z, dx, dy, dz);
+}
+
+void BSplineCurves3D::Bezier::ValuesAt(const QVector3D* points, int pointCount, const float* t, int count, float* x, float* y, float* z, float* dx, float* dy, float* dz)
+{
+    if (pointCount == 4)
+    {
+        BezierBatch::EvaluateCubic(points, t, count, x, y, z, dx, dy, dz);
+        return;
+    }
+
+    int n = pointCount - 1;
+    bool derivatives = dx && dy && dz;
+
+    for (int i = 0; i < count; ++i)
+    {
+        QVector3D value = QVector3D(0, 0, 0);
+
+        for (int k = 0; k <= n; k++)
+            value += Choose(n, k) * pow(t[i], k) * pow(1 - t[i], n - k) * points[k];
+
+        x[i] = value.x();
+        y[i] = value.y();
+        z[i] = value.z();
+
+        if (derivatives)
+        {
+            QVector3D derivative = QVector3D(0, 0, 0);
+
+            for (int k = 0; k <= n - 1; k++)
+                derivative += n * Choose(n - 1, k) * pow(t[i], k) * pow(1 - t[i], n - 1 - k) * (points[k + 1] - points[k]);
+
+            dx[i] = derivative.x();
+            dy[i] = derivative.y();
+            dz[i] = derivative.z();
+        }
+    }
+}
+
+void BSplineCurves3D::Bezier::ValuesAtUniformTicks(const QVector3D* points, int pointCount, int segments, float* x, float* y, float* z, float* dx, float* dy, float* dz)
+{
+    if (pointCount == 4)
+    {
+        BezierBatch::EvaluateCubicUniform(points, segments, x, y, z, dx, dy, dz);
+        return;
+    }
+
+    QVector<float> t(segments + 1);
+
+    for (int i = 0; i <= segments; ++i)
+        t[i] = float(i) / segments;
+
+    ValuesAt(points, pointCount, t.constData(), segments + 1, x, y, z, dx, dy, dz);
+}
+
 int BSplineCurves3D::Bezier::GetDegree() const
 {
     return mControlPoints.size() - 1;
 }
 
-float BSplineCurves3D::Bezier::Factorial(int n) const
+float BSplineCurves3D::Bezier::Factorial(int n)
 {
     float result = 1.0f;
 
@@ -127,27 +218,45 @@ float BSplineCurves3D::Bezier::Factorial(int n) const
     return result;
 }
 
-float BSplineCurves3D::Bezier::Choose(int n, int k) const
+float BSplineCurves3D::Bezier::Choose(int n, int k)
 {
     return Factorial(n) / (Factorial(k) * Factorial(n - k));
 }
 
 float BSplineCurves3D::Bezier::ClosestDistanceToRay(const QVector3D& rayOrigin, const QVector3D& rayDirection, float epsilon)
 {
+    constexpr int CHUNK = 64;
+
     float minDistance = std::numeric_limits<float>::infinity();
+    int sampleCount = int(1.0f / epsilon) + 1;
 
-    for (float t = 0.0f; t <= 1.0f; t += epsilon)
+    float t[CHUNK];
+    float x[CHUNK];
+    float y[CHUNK];
+    float z[CHUNK];
+
+    for (int begin = 0; begin < sampleCount; begin += CHUNK)
     {
-        QVector3D difference = ValueAt(t) - rayOrigin;
+        int count = qMin(CHUNK, sampleCount - begin);
 
-        float dot = QVector3D::dotProduct(difference, rayDirection);
+        for (int i = 0; i < count; ++i)
+            t[i] = qMin(1.0f, (begin + i) * epsilon);
 
-        if (dot >= 0.0f)
+        ValuesAt(t, count, x, y, z);
+
+        for (int i = 0; i < count; ++i)
         {
-            float distance = (difference - rayDirection * dot).length();
-            if (distance < minDistance)
+            QVector3D difference = QVector3D(x[i], y[i], z[i]) - rayOrigin;
+
+            float dot = QVector3D::dotProduct(difference, rayDirection);
+
+            if (dot >= 0.0f)
             {
-                minDistance = distance;
+                float distance = (difference - rayDirection * dot).length();
+                if (distance < minDistance)
+                {
+                    minDistance = distance;
+                }
             }
         }
     }
@@ -157,16 +266,8 @@ float BSplineCurves3D::Bezier::ClosestDistanceToRay(const QVector3D& rayOrigin,
 
 void BSplineCurves3D::Bezier::Update()
 {
-    float epsilon = 0.01f;
-    float length = 0.0f;
-
-    for (float t = epsilon; t <= 1.0f; t += epsilon)
-    {
-        float delta = (ValueAt(t - epsilon) - ValueAt(t)).length();
-        length += delta;
-    }
-
-    mLength = length;
+    // Cached until a control point changes, see Length
+    mLength = ArcLength::Compute(mControlPoints.constData(), mControlPoints.size(), 0.0f, 1.0f, mLengthTolerance);
 
     mDirty = false;
 }
@@ -175,8 +276,12 @@ void BSplineCurves3D::Bezier::Translate(const QVector3D& translation)
 {
     for (auto& controlPoint : mControlPoints)
     {
-        controlPoint->SetPosition(controlPoint->GetPosition() + translation);
+        controlPoint += translation;
     }
+
+    MarkDirty();
+    mVertexGenerationStatus = VertexGenerationStatus::Dirty;
+    mMeshValid = false;
 }
 
 float BSplineCurves3D::Bezier::Length()
@@ -187,132 +292,234 @@ float BSplineCurves3D::Bezier::Length()
     return mLength;
 }
 
-void BSplineCurves3D::Bezier::GenerateVertices()
+void BSplineCurves3D::Bezier::GenerateVertices(int priority)
 {
     mVertexGenerationStatus = VertexGenerationStatus::GeneratingVertices;
 
-    QtConcurrent::run([=]()
-        {
-            mVertices.clear();
-            mNormals.clear();
+    // The job works on a snapshot, the new generation supersedes every job still running for this patch
+    TessellationJob job = CreateTessellationJob(mLevelOfDetail);
 
-            mVertices.reserve(4 * mSectorCount * mTickCount);
-            mNormals.reserve(4 * mSectorCount * mTickCount);
+    mSubmittedLevelOfDetail = mLevelOfDetail;
+    job.generation = mTessellationChannel->generation.fetchAndAddOrdered(1) + 1;
+    job.priority = priority;
 
-            float dt = 1.0f / mTickCount;
-            float r = mRadius;
+    // Published right away on a hit, the render thread takes it like any other mesh
+    TessellationMesh* mesh = mTessellationChannel->AcquireMesh();
 
-            for (float t = 0.0f; t <= 1.0f - dt; t += dt)
-            {
-                float t0 = t;
-                float t1 = t0 + dt;
+    if (TessellationCache::Instance()->Find(job, *mesh))
+    {
+        mesh->generation = job.generation;
+        mTessellationChannel->Publish(mesh);
+        return;
+    }
 
-                QVector3D value0 = ValueAt(t0);
-                QVector3D value1 = ValueAt(t1);
+    mTessellationChannel->ReleaseMesh(mesh);
 
-                QVector3D tangent0 = TangentAt(t0);
-                QVector3D tangent1 = TangentAt(t1);
+    TessellationScheduler::Instance()->Submit(job);
+}
 
-                QVector3D axis = QVector3D::crossProduct(QVector3D(1, 0, 0), tangent0);
-                float angle = acos(QVector3D::dotProduct(QVector3D(1, 0, 0), tangent0));
+BSplineCurves3D::TessellationJob BSplineCurves3D::Bezier::CreateTessellationJob(int levelOfDetail) const
+{
+    TessellationJob job;
+    job.channel = mTessellationChannel;
+    job.controlPoints = mControlPoints;
+    job.tessellation = mTessellation;
+    job.tickCount = mTickCount;
+    job.sectorCount = mSectorCount;
+    job.radius = mRadius;
+    job.startNormal = mStartNormal;
+    job.endNormal = mEndNormal;
+
+    // Every level halves the sectors and the ticks. Chord height grows with the square of the segment length.
+    if (levelOfDetail > 0)
+    {
+        job.sectorCount = qMin(mSectorCount, qMax(MIN_LEVEL_OF_DETAIL_COUNT, mSectorCount >> levelOfDetail));
+        job.tickCount = qMin(mTickCount, qMax(MIN_LEVEL_OF_DETAIL_COUNT, mTickCount >> levelOfDetail));
+        job.tessellation.chordTolerance *= 1 << (2 * levelOfDetail);
+        job.tessellation.angleTolerance *= 1 << levelOfDetail;
+    }
 
-                if (abs(angle) < 0.00001f || abs(angle - M_PI) < 0.00001f)
-                {
-                    axis = QVector3D(0, 1, 0);
-                }
+    return job;
+}
 
-                QQuaternion rotation = QQuaternion::fromAxisAndAngle(axis, qRadiansToDegrees(angle));
+void BSplineCurves3D::Bezier::InitializeOpenGLStuff()
+{
+    initializeOpenGLFunctions();
 
-                for (int i = 0; i < mSectorCount; ++i)
-                {
-                    float sectorAngle0 = 2 * float(i) / mSectorCount * M_PI;
-                    float sectorAngle1 = 2 * float(i + 1) / mSectorCount * M_PI;
+    // Buffers come from the BufferArena once the first mesh is known
+    mVertexArray.create();
 
-                    QVector3D position00 = value0 + rotation * QVector3D(0, r * cos(sectorAngle0), r * sin(sectorAngle0));
-                    QVector3D position01 = value0 + rotation * QVector3D(0, r * cos(sectorAngle1), r * sin(sectorAngle1));
-                    QVector3D position10 = Helper::ProjectOntoPlane(tangent1, value1, position00);
-                    QVector3D position11 = Helper::ProjectOntoPlane(tangent1, value1, position01);
+    mInitialized = true;
+}
 
-                    QVector3D normal = QVector3D::crossProduct((position10 - position00).normalized(), (position11 - position00).normalized());
+void BSplineCurves3D::Bezier::ConfigureVertexArray()
+{
+    const qint64 offset = mVertexAllocation->offset;
 
-                    mVertices << position10;
-                    mVertices << position00;
-                    mVertices << position11;
-                    mVertices << position01;
+    mVertexArray.bind();
+    mVertexAllocation->buffer->bind();
 
-                    mNormals << normal;
-                    mNormals << normal;
-                    mNormals << normal;
-                    mNormals << normal;
-                }
-            }
+    if (mPackedVertices)
+    {
+        // Interleaved, see PackedVertex
+        glVertexAttribPointer(0,
+            3,                              // Size
+            GL_SHORT,                       // Type
+            GL_TRUE,                        // Normalized
+            sizeof(PackedVertex),           // Stride
+            reinterpret_cast<void*>(offset) // Offset
+        );
+        glEnableVertexAttribArray(0);
+
+        glVertexAttribPointer(1,
+            2,                                                               // Size
+            GL_SHORT,                                                        // Type
+            GL_TRUE,                                                         // Normalized
+            sizeof(PackedVertex),                                            // Stride
+            reinterpret_cast<void*>(offset + offsetof(PackedVertex, normal)) // Offset
+        );
+        glEnableVertexAttribArray(1);
+    }
+    else
+    {
+        // Normals follow the positions
+        glVertexAttribPointer(0,
+            3,                              // Size
+            GL_FLOAT,                       // Type
+            GL_FALSE,                       // Normalized
+            sizeof(QVector3D),              // Stride
+            reinterpret_cast<void*>(offset) // Offset
+        );
+        glEnableVertexAttribArray(0);
+
+        glVertexAttribPointer(1,
+            3,                                                                         // Size
+            GL_FLOAT,                                                                  // Type
+            GL_FALSE,                                                                  // Normalized
+            sizeof(QVector3D),                                                         // Stride
+            reinterpret_cast<void*>(offset + sizeof(QVector3D) * mUploadedVertexCount) // Offset
+        );
+        glEnableVertexAttribArray(1);
+    }
+
+    mVertexAllocation->buffer->release();
 
-            mVertexGenerationStatus = VertexGenerationStatus::WaitingForOpenGLUpdate;
-        });
+    // Not released, the binding is part of the vertex array state
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndexAllocation->buffer->bufferId());
+
+    mVertexArray.release();
+
+    mVertexAllocationGeneration = mVertexAllocation->generation;
+    mIndexAllocationGeneration = mIndexAllocation->generation;
 }
 
-void BSplineCurves3D::Bezier::InitializeOpenGLStuff()
+bool BSplineCurves3D::Bezier::TakeMesh()
 {
-    mVertexArray.create();
-    mVertexArray.bind();
+    TessellationMesh* mesh = mTessellationChannel->Take();
 
-    // Vertices
-    mVertexBuffer.create();
-    mVertexBuffer.bind();
-    mVertexBuffer.setUsagePattern(QOpenGLBuffer::UsagePattern::DynamicDraw);
-    mVertexBuffer.allocate(sizeof(QVector3D) * 6 * 256 * mTickCount);
-    glVertexAttribPointer(0,
-        3,                 // Size
-        GL_FLOAT,          // Type
-        GL_FALSE,          // Normalized
-        sizeof(QVector3D), // Stride
-        nullptr            // Offset
-    );
-
-    glEnableVertexAttribArray(0);
-    mVertexBuffer.release();
-
-    // Normals
-    mNormalBuffer.create();
-    mNormalBuffer.bind();
-    mNormalBuffer.setUsagePattern(QOpenGLBuffer::UsagePattern::DynamicDraw);
-    mNormalBuffer.allocate(sizeof(QVector3D) * 6 * 256 * mTickCount);
-
-    glVertexAttribPointer(1,
-        3,                 // Size
-        GL_FLOAT,          // Type
-        GL_FALSE,          // Normalized
-        sizeof(QVector3D), // Stride
-        nullptr            // Offset
-    );
-    glEnableVertexAttribArray(1);
-    mNormalBuffer.release();
-    mVertexArray.release();
+    if (!mesh)
+        return false;
 
-    mInitialized = true;
+    // Finished before it noticed that it was superseded, the newer job is still running
+    if (mesh->generation != mTessellationChannel->generation.loadAcquire())
+    {
+        mTessellationChannel->ReleaseMesh(mesh);
+        return false;
+    }
+
+    ReleaseMesh();
+    mMesh = mesh;
+
+    mVertexCount = mesh->vertices.size();
+    mIndexCount = mesh->indices.size();
+    mMeshLevelOfDetail = mSubmittedLevelOfDetail;
+    mMeshValid = true;
+    mVertexGenerationStatus = VertexGenerationStatus::Ready;
+
+    return true;
+}
+
+const BSplineCurves3D::TessellationMesh* BSplineCurves3D::Bezier::GetMesh() const
+{
+    return mMesh;
+}
+
+void BSplineCurves3D::Bezier::ReleaseMesh()
+{
+    // The mesh becomes the back buffer of the next job
+    if (mMesh)
+        mTessellationChannel->ReleaseMesh(mMesh);
+
+    mMesh = nullptr;
+}
+
+void BSplineCurves3D::Bezier::DetachMesh()
+{
+    if (mMesh)
+        TessellationCache::Detach(*mMesh);
 }
 
 void BSplineCurves3D::Bezier::UpdateOpenGLStuff()
 {
-    mVertexArray.bind();
+    // A mesh taken while the curve was drawn as a whole is uploaded as well
+    TakeMesh();
 
-    mVertexBuffer.bind();
-    mVertexBuffer.write(0, mVertices.constData(), sizeof(QVector3D) * mVertices.size());
-    mVertexBuffer.release();
+    if (!mMesh)
+        return;
 
-    mNormalBuffer.bind();
-    mNormalBuffer.write(0, mNormals.constData(), sizeof(QVector3D) * mNormals.size());
-    mNormalBuffer.release();
+    const TessellationMesh* mesh = mMesh;
+    BufferArena* arena = BufferArena::Instance();
 
-    mVertexArray.release();
+    // Exactly sized ranges, adaptive tessellation and levels of detail change the vertex count
+    if (mesh->packed)
+    {
+        qint64 size = sizeof(PackedVertex) * mesh->packedVertices.size();
 
-    mVertexGenerationStatus = VertexGenerationStatus::Ready;
+        mVertexAllocation = arena->Reallocate(mVertexAllocation, BufferArena::Pool::Vertex, size);
+        arena->Write(mVertexAllocation, 0, mesh->packedVertices.constData(), size);
+
+        mPackedOrigin = mesh->origin;
+        mPackedScale = mesh->scale;
+    }
+    else
+    {
+        qint64 size = sizeof(QVector3D) * mesh->vertices.size();
+
+        mVertexAllocation = arena->Reallocate(mVertexAllocation, BufferArena::Pool::Vertex, 2 * size);
+        arena->Write(mVertexAllocation, 0, mesh->vertices.constData(), size);
+        arena->Write(mVertexAllocation, size, mesh->normals.constData(), size);
+    }
+
+    // Indices only depend on the ring and sector counts, which the vertex and index counts determine
+    if (!mIndexAllocation || mesh->vertices.size() != mUploadedVertexCount || mesh->indices.size() != mUploadedIndexCount)
+    {
+        qint64 size = sizeof(quint32) * mesh->indices.size();
+
+        mIndexAllocation = arena->Reallocate(mIndexAllocation, BufferArena::Pool::Index, size);
+        arena->Write(mIndexAllocation, 0, mesh->indices.constData(), size);
+    }
+
+    mPackedVertices = mesh->packed;
+    mUploadedVertexCount = mesh->vertices.size();
+    mUploadedIndexCount = mesh->indices.size();
+
+    ConfigureVertexArray();
+
+    // The GPU has its own copy
+    ReleaseMesh();
 }
 
 void BSplineCurves3D::Bezier::Render()
 {
+    if (!mVertexAllocation || !mIndexAllocation)
+        return;
+
+    // Moved by BufferArena::Defragment
+    if (mVertexAllocation->generation != mVertexAllocationGeneration || mIndexAllocation->generation != mIndexAllocationGeneration)
+        ConfigureVertexArray();
+
     mVertexArray.bind();
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, mVertices.size());
+    glDrawElements(GL_TRIANGLES, mUploadedIndexCount, GL_UNSIGNED_INT, reinterpret_cast<void*>(mIndexAllocation->offset));
     mVertexArray.release();
 }
 
@@ -325,6 +532,7 @@ void BSplineCurves3D::Bezier::SetSectorCount(int newSectorCount)
 {
     mSectorCount = newSectorCount;
     mVertexGenerationStatus = VertexGenerationStatus::Dirty;
+    mMeshValid = false;
 }
 
 float BSplineCurves3D::Bezier::GetRadius() const
@@ -336,10 +544,15 @@ void BSplineCurves3D::Bezier::SetRadius(float newRadius)
 {
     mRadius = newRadius;
     mVertexGenerationStatus = VertexGenerationStatus::Dirty;
+    mMeshValid = false;
 }
 
 BSplineCurves3D::Bezier::VertexGenerationStatus BSplineCurves3D::Bezier::GetVertexGenerationStatus() const
 {
+    // Jobs never touch the patch, a published mesh is how they report back
+    if (mVertexGenerationStatus == VertexGenerationStatus::GeneratingVertices && mTessellationChannel->published.loadAcquire())
+        return VertexGenerationStatus::WaitingForOpenGLUpdate;
+
     return mVertexGenerationStatus;
 }
 
@@ -358,14 +571,116 @@ void BSplineCurves3D::Bezier::SetInitialized(bool newInitialized)
     mInitialized = newInitialized;
 }
 
-BSplineCurves3D::ControlPoint* BSplineCurves3D::Bezier::GetClosestControlPointToRay(const QVector3D& rayOrigin, const QVector3D& rayDirection, float maxDistance)
+const BSplineCurves3D::Bezier::Tessellation& BSplineCurves3D::Bezier::GetTessellation() const
+{
+    return mTessellation;
+}
+
+void BSplineCurves3D::Bezier::SetTessellation(const Tessellation& newTessellation)
+{
+    mTessellation = newTessellation;
+    mVertexGenerationStatus = VertexGenerationStatus::Dirty;
+    mMeshValid = false;
+}
+
+float BSplineCurves3D::Bezier::GetControlPointTolerance() const
+{
+    return mControlPointTolerance;
+}
+
+void BSplineCurves3D::Bezier::SetControlPointTolerance(float newControlPointTolerance)
+{
+    mControlPointTolerance = newControlPointTolerance;
+}
+
+float BSplineCurves3D::Bezier::GetLengthTolerance() const
+{
+    return mLengthTolerance;
+}
+
+void BSplineCurves3D::Bezier::SetLengthTolerance(float newLengthTolerance)
+{
+    mLengthTolerance = newLengthTolerance;
+    mDirty = true;
+}
+
+int BSplineCurves3D::Bezier::GetVertexCount() const
+{
+    return mVertexCount;
+}
+
+qint64 BSplineCurves3D::Bezier::GetMeshBytes() const
+{
+    qint64 vertexSize = mPackedVertices ? sizeof(PackedVertex) : 2 * sizeof(QVector3D);
+
+    return vertexSize * mVertexCount + qint64(sizeof(quint32)) * mIndexCount;
+}
+
+int BSplineCurves3D::Bezier::GetTriangleCount() const
+{
+    return mIndexCount / 3;
+}
+
+qint64 BSplineCurves3D::Bezier::GetFullDetailTriangleCount() const
+{
+    if (mIndexCount == 0)
+        return 0;
+
+    // Rings have mVertexCount - mIndexCount / 6 sectors, see TessellationScheduler::Tessellate
+    int sectorCount = mVertexCount - mIndexCount / 6;
+
+    return qint64(GetTriangleCount()) * mSectorCount / qMax(1, sectorCount) << mMeshLevelOfDetail;
+}
+
+int BSplineCurves3D::Bezier::GetLevelOfDetail() const
+{
+    return mLevelOfDetail;
+}
+
+void BSplineCurves3D::Bezier::SetLevelOfDetail(int newLevelOfDetail)
+{
+    if (mLevelOfDetail == newLevelOfDetail)
+        return;
+
+    // The current mesh keeps being drawn until the new level is uploaded
+    mLevelOfDetail = newLevelOfDetail;
+    mVertexGenerationStatus = VertexGenerationStatus::Dirty;
+}
+
+bool BSplineCurves3D::Bezier::GetMeshValid() const
+{
+    return mMeshValid;
+}
+
+bool BSplineCurves3D::Bezier::GetPackedVertices() const
+{
+    return mPackedVertices;
+}
+
+const QVector3D& BSplineCurves3D::Bezier::GetPackedOrigin() const
+{
+    return mPackedOrigin;
+}
+
+float BSplineCurves3D::Bezier::GetPackedScale() const
+{
+    return mPackedScale;
+}
+
+qint64 BSplineCurves3D::Bezier::GetUnindexedMeshBytes() const
+{
+    // Four vertices and four flat normals per quad, each quad has six indices
+    return qint64(2 * sizeof(QVector3D)) * 4 * (mIndexCount / 6);
+}
+
+int BSplineCurves3D::Bezier::GetClosestControlPointToRay(const QVector3D& rayOrigin, const QVector3D& rayDirection, float maxDistance)
 {
     float minDistance = std::numeric_limits<float>::infinity();
-    ControlPoint* closestControlPoint = nullptr;
+    int closestControlPoint = -1;
 
-    for (auto& controlPoint : mControlPoints)
+    for (int i = 0; i < mControlPoints.size(); ++i)
     {
-        QVector3D difference = controlPoint->GetPosition() - rayOrigin;
+        QVector3D difference = mControlPoints[i] - rayOrigin;
 
         float dot = QVector3D::dotProduct(difference, rayDirection);
 
@@ -375,13 +690,13 @@ BSplineCurves3D::ControlPoint* BSplineCurves3D::Bezier::GetClosestControlPointTo
             if (distance < minDistance)
             {
                 minDistance = distance;
-                closestControlPoint = controlPoint;
+                closestControlPoint = i;
             }
         }
     }
 
     if (minDistance >= maxDistance)
-        closestControlPoint = nullptr;
+        closestControlPoint = -1;
 
     return closestControlPoint;
 }
\ No newline at end of file
@@ -0,0 +1,433 @@
+#include "BezierBatch.h"
+#include "Simd.h"
+
+#include <QtGlobal>
+
+BSplineCurves3D::BezierBatch::BezierBatch() {}
+
+void BSplineCurves3D::BezierBatch::EvaluateCubic(const QVector3D* points, const float* t, int count, float* x, float* y, float* z, float* dx, float* dy, float* dz)
+{
+    const Coefficients coefficients = PowerBasis(points);
+
+    float* values[3] = { x, y, z };
+    float* derivatives[3] = { dx, dy, dz };
+    float* const* derivativesOrNull = (dx && dy && dz) ? derivatives : nullptr;
+
+    int done = 0;
+
+    switch (GetInstructionSet())
+    {
+    case InstructionSet::AVX2:
+        done = EvaluateAVX2(coefficients, t, count, values, derivativesOrNull);
+        break;
+    case InstructionSet::SSE:
+        done = EvaluateSSE(coefficients, t, count, values, derivativesOrNull);
+        break;
+    case InstructionSet::Scalar:
+        break;
+    }
+
+    // Remainder which does not fill a whole register
+    EvaluateScalar(coefficients, t, done, count, values, derivativesOrNull);
+}
+
+void BSplineCurves3D::BezierBatch::EvaluateCubicUniform(const QVector3D* points, int segments, float* x, float* y, float* z, float* dx, float* dy, float* dz)
+{
+    const Coefficients coefficients = PowerBasis(points);
+
+    float* values[3] = { x, y, z };
+    float* derivatives[3] = { dx, dy, dz };
+    float* const* derivativesOrNull = (dx && dy && dz) ? derivatives : nullptr;
+
+    int done = 0;
+
+    switch (GetInstructionSet())
+    {
+    case InstructionSet::AVX2:
+        done = ForwardDifferenceAVX2(coefficients, segments, values, derivativesOrNull);
+        break;
+    case InstructionSet::SSE:
+        done = ForwardDifferenceSSE(coefficients, segments, values, derivativesOrNull);
+        break;
+    case InstructionSet::Scalar:
+        break;
+    }
+
+    // Remainder which does not fill a whole register
+    ForwardDifferenceScalar(coefficients, segments, done, values, derivativesOrNull);
+}
+
+BSplineCurves3D::BezierBatch::InstructionSet BSplineCurves3D::BezierBatch::GetInstructionSet()
+{
+    static const InstructionSet instructionSet = DetectInstructionSet();
+
+    return instructionSet;
+}
+
+const char* BSplineCurves3D::BezierBatch::GetInstructionSetName()
+{
+    switch (GetInstructionSet())
+    {
+    case InstructionSet::AVX2:
+        return "AVX2";
+    case InstructionSet::SSE:
+        return "SSE";
+    default:
+        return "Scalar";
+    }
+}
+
+BSplineCurves3D::BezierBatch::Coefficients BSplineCurves3D::BezierBatch::PowerBasis(const QVector3D* points)
+{
+    // P(t) = ((a * t + b) * t + c) * t + d and P'(t) = (3 * a * t + 2 * b) * t + c
+    Coefficients coefficients;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        coefficients.a[i] = -points[0][i] + 3 * points[1][i] - 3 * points[2][i] + points[3][i];
+        coefficients.b[i] = 3 * points[0][i] - 6 * points[1][i] + 3 * points[2][i];
+        coefficients.c[i] = -3 * points[0][i] + 3 * points[1][i];
+        coefficients.d[i] = points[0][i];
+    }
+
+    return coefficients;
+}
+
+void BSplineCurves3D::BezierBatch::EvaluateScalar(const Coefficients& coefficients, const float* t, int begin, int end, float* const* values, float* const* derivatives)
+{
+    for (int j = 0; j < 3; ++j)
+    {
+        const float a = coefficients.a[j];
+        const float b = coefficients.b[j];
+        const float c = coefficients.c[j];
+        const float d = coefficients.d[j];
+
+        for (int i = begin; i < end; ++i)
+            values[j][i] = ((a * t[i] + b) * t[i] + c) * t[i] + d;
+
+        if (derivatives)
+            for (int i = begin; i < end; ++i)
+                derivatives[j][i] = (3 * a * t[i] + 2 * b) * t[i] + c;
+    }
+}
+
+int BSplineCurves3D::BezierBatch::EvaluateSSE(const Coefficients& coefficients, const float* t, int count, float* const* values, float* const* derivatives)
+{
+#ifdef BSPLINE_X86
+    const int end = count - count % 4;
+
+    for (int j = 0; j < 3; ++j)
+    {
+        const __m128 a = _mm_set1_ps(coefficients.a[j]);
+        const __m128 b = _mm_set1_ps(coefficients.b[j]);
+        const __m128 c = _mm_set1_ps(coefficients.c[j]);
+        const __m128 d = _mm_set1_ps(coefficients.d[j]);
+        const __m128 a3 = _mm_set1_ps(3 * coefficients.a[j]);
+        const __m128 b2 = _mm_set1_ps(2 * coefficients.b[j]);
+
+        for (int i = 0; i < end; i += 4)
+        {
+            const __m128 ti = _mm_loadu_ps(t + i);
+            __m128 value = _mm_add_ps(_mm_mul_ps(a, ti), b);
+            value = _mm_add_ps(_mm_mul_ps(value, ti), c);
+            value = _mm_add_ps(_mm_mul_ps(value, ti), d);
+            _mm_storeu_ps(values[j] + i, value);
+
+            if (derivatives)
+            {
+                __m128 derivative = _mm_add_ps(_mm_mul_ps(a3, ti), b2);
+                derivative = _mm_add_ps(_mm_mul_ps(derivative, ti), c);
+                _mm_storeu_ps(derivatives[j] + i, derivative);
+            }
+        }
+    }
+
+    return end;
+#else
+    Q_UNUSED(coefficients);
+    Q_UNUSED(t);
+    Q_UNUSED(count);
+    Q_UNUSED(values);
+    Q_UNUSED(derivatives);
+    return 0;
+#endif
+}
+
+BSPLINE_TARGET_AVX2 int BSplineCurves3D::BezierBatch::EvaluateAVX2(const Coefficients& coefficients, const float* t, int count, float* const* values, float* const* derivatives)
+{
+#ifdef BSPLINE_X86
+    const int end = count - count % 8;
+
+    for (int j = 0; j < 3; ++j)
+    {
+        const __m256 a = _mm256_set1_ps(coefficients.a[j]);
+        const __m256 b = _mm256_set1_ps(coefficients.b[j]);
+        const __m256 c = _mm256_set1_ps(coefficients.c[j]);
+        const __m256 d = _mm256_set1_ps(coefficients.d[j]);
+        const __m256 a3 = _mm256_set1_ps(3 * coefficients.a[j]);
+        const __m256 b2 = _mm256_set1_ps(2 * coefficients.b[j]);
+
+        for (int i = 0; i < end; i += 8)
+        {
+            const __m256 ti = _mm256_loadu_ps(t + i);
+            __m256 value = _mm256_add_ps(_mm256_mul_ps(a, ti), b);
+            value = _mm256_add_ps(_mm256_mul_ps(value, ti), c);
+            value = _mm256_add_ps(_mm256_mul_ps(value, ti), d);
+            _mm256_storeu_ps(values[j] + i, value);
+
+            if (derivatives)
+            {
+                __m256 derivative = _mm256_add_ps(_mm256_mul_ps(a3, ti), b2);
+                derivative = _mm256_add_ps(_mm256_mul_ps(derivative, ti), c);
+                _mm256_storeu_ps(derivatives[j] + i, derivative);
+            }
+        }
+    }
+
+    return end;
+#else
+    Q_UNUSED(coefficients);
+    Q_UNUSED(t);
+    Q_UNUSED(count);
+    Q_UNUSED(values);
+    Q_UNUSED(derivatives);
+    return 0;
+#endif
+}
+
+void BSplineCurves3D::BezierBatch::ForwardDifferenceScalar(const Coefficients& coefficients, int segments, int begin, float* const* values, float* const* derivatives)
+{
+    const float h = 1.0f / segments;
+
+    for (int j = 0; j < 3; ++j)
+    {
+        const float a = coefficients.a[j];
+        const float b = coefficients.b[j];
+        const float c = coefficients.c[j];
+        const float d = coefficients.d[j];
+
+        for (int anchor = begin; anchor <= segments; anchor += REANCHOR_INTERVAL)
+        {
+            const int end = qMin(anchor + REANCHOR_INTERVAL, segments + 1);
+            const float t = float(anchor) / segments;
+
+            // Differences of P at the anchor, the third one is constant
+            float value = ((a * t + b) * t + c) * t + d;
+            float delta1 = h * ((3 * a * t + 3 * a * h + 2 * b) * t + (a * h + b) * h + c);
+            float delta2 = h * h * (6 * a * t + 6 * a * h + 2 * b);
+            const float delta3 = 6 * a * h * h * h;
+
+            for (int i = anchor; i < end; ++i)
+            {
+                values[j][i] = value;
+                value += delta1;
+                delta1 += delta2;
+                delta2 += delta3;
+            }
+
+            if (!derivatives)
+                continue;
+
+            // Differences of P', the second one is constant
+            float derivative = (3 * a * t + 2 * b) * t + c;
+            float epsilon1 = h * (6 * a * t + 3 * a * h + 2 * b);
+            const float epsilon2 = 6 * a * h * h;
+
+            for (int i = anchor; i < end; ++i)
+            {
+                derivatives[j][i] = derivative;
+                derivative += epsilon1;
+                epsilon1 += epsilon2;
+            }
+        }
+    }
+}
+
+int BSplineCurves3D::BezierBatch::ForwardDifferenceSSE(const Coefficients& coefficients, int segments, float* const* values, float* const* derivatives)
+{
+#ifdef BSPLINE_X86
+    const int end = (segments + 1) - (segments + 1) % 4;
+    const float h = 4.0f / segments; // Step of a lane
+    const __m128 lanes = _mm_setr_ps(0, 1, 2, 3);
+    const __m128 divisor = _mm_set1_ps(float(segments));
+
+    for (int j = 0; j < 3; ++j)
+    {
+        const float a = coefficients.a[j];
+        const float b = coefficients.b[j];
+
+        const __m128 va = _mm_set1_ps(a);
+        const __m128 vb = _mm_set1_ps(b);
+        const __m128 vc = _mm_set1_ps(coefficients.c[j]);
+        const __m128 vd = _mm_set1_ps(coefficients.d[j]);
+        const __m128 a3 = _mm_set1_ps(3 * a);
+        const __m128 a6 = _mm_set1_ps(6 * a);
+        const __m128 b2 = _mm_set1_ps(2 * b);
+        const __m128 vh = _mm_set1_ps(h);
+        const __m128 hh = _mm_set1_ps(h * h);
+        const __m128 delta1Linear = _mm_set1_ps(3 * a * h + 2 * b);
+        const __m128 delta1Constant = _mm_set1_ps((a * h + b) * h + coefficients.c[j]);
+        const __m128 delta2Constant = _mm_set1_ps(6 * a * h + 2 * b);
+        const __m128 delta3 = _mm_set1_ps(6 * a * h * h * h);
+        const __m128 epsilon1Constant = _mm_set1_ps(3 * a * h + 2 * b);
+        const __m128 epsilon2 = _mm_set1_ps(6 * a * h * h);
+
+        for (int anchor = 0; anchor < end; anchor += 4 * REANCHOR_INTERVAL)
+        {
+            const int blockEnd = qMin(anchor + 4 * REANCHOR_INTERVAL, end);
+            const __m128 t = _mm_div_ps(_mm_add_ps(_mm_set1_ps(float(anchor)), lanes), divisor);
+
+            __m128 value = _mm_add_ps(_mm_mul_ps(va, t), vb);
+            value = _mm_add_ps(_mm_mul_ps(value, t), vc);
+            value = _mm_add_ps(_mm_mul_ps(value, t), vd);
+
+            __m128 delta1 = _mm_add_ps(_mm_mul_ps(a3, t), delta1Linear);
+            delta1 = _mm_mul_ps(vh, _mm_add_ps(_mm_mul_ps(delta1, t), delta1Constant));
+            __m128 delta2 = _mm_mul_ps(hh, _mm_add_ps(_mm_mul_ps(a6, t), delta2Constant));
+
+            __m128 derivative = _mm_add_ps(_mm_mul_ps(a3, t), b2);
+            derivative = _mm_add_ps(_mm_mul_ps(derivative, t), vc);
+            __m128 epsilon1 = _mm_mul_ps(vh, _mm_add_ps(_mm_mul_ps(a6, t), epsilon1Constant));
+
+            for (int i = anchor; i < blockEnd; i += 4)
+            {
+                _mm_storeu_ps(values[j] + i, value);
+                value = _mm_add_ps(value, delta1);
+                delta1 = _mm_add_ps(delta1, delta2);
+                delta2 = _mm_add_ps(delta2, delta3);
+
+                if (derivatives)
+                {
+                    _mm_storeu_ps(derivatives[j] + i, derivative);
+                    derivative = _mm_add_ps(derivative, epsilon1);
+                    epsilon1 = _mm_add_ps(epsilon1, epsilon2);
+                }
+            }
+        }
+    }
+
+    return end;
+#else
+    Q_UNUSED(coefficients);
+    Q_UNUSED(segments);
+    Q_UNUSED(values);
+    Q_UNUSED(derivatives);
+    return 0;
+#endif
+}
+
+BSPLINE_TARGET_AVX2 int BSplineCurves3D::BezierBatch::ForwardDifferenceAVX2(const Coefficients& coefficients, int segments, float* const* values, float* const* derivatives)
+{
+#ifdef BSPLINE_X86
+    const int end = (segments + 1) - (segments + 1) % 8;
+    const float h = 8.0f / segments; // Step of a lane
+    const __m256 lanes = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 divisor = _mm256_set1_ps(float(segments));
+
+    for (int j = 0; j < 3; ++j)
+    {
+        const float a = coefficients.a[j];
+        const float b = coefficients.b[j];
+
+        const __m256 va = _mm256_set1_ps(a);
+        const __m256 vb = _mm256_set1_ps(b);
+        const __m256 vc = _mm256_set1_ps(coefficients.c[j]);
+        const __m256 vd = _mm256_set1_ps(coefficients.d[j]);
+        const __m256 a3 = _mm256_set1_ps(3 * a);
+        const __m256 a6 = _mm256_set1_ps(6 * a);
+        const __m256 b2 = _mm256_set1_ps(2 * b);
+        const __m256 vh = _mm256_set1_ps(h);
+        const __m256 hh = _mm256_set1_ps(h * h);
+        const __m256 delta1Linear = _mm256_set1_ps(3 * a * h + 2 * b);
+        const __m256 delta1Constant = _mm256_set1_ps((a * h + b) * h + coefficients.c[j]);
+        const __m256 delta2Constant = _mm256_set1_ps(6 * a * h + 2 * b);
+        const __m256 delta3 = _mm256_set1_ps(6 * a * h * h * h);
+        const __m256 epsilon1Constant = _mm256_set1_ps(3 * a * h + 2 * b);
+        const __m256 epsilon2 = _mm256_set1_ps(6 * a * h * h);
+
+        for (int anchor = 0; anchor < end; anchor += 8 * REANCHOR_INTERVAL)
+        {
+            const int blockEnd = qMin(anchor + 8 * REANCHOR_INTERVAL, end);
+            const __m256 t = _mm256_div_ps(_mm256_add_ps(_mm256_set1_ps(float(anchor)), lanes), divisor);
+
+            __m256 value = _mm256_add_ps(_mm256_mul_ps(va, t), vb);
+            value = _mm256_add_ps(_mm256_mul_ps(value, t), vc);
+            value = _mm256_add_ps(_mm256_mul_ps(value, t), vd);
+
+            __m256 delta1 = _mm256_add_ps(_mm256_mul_ps(a3, t), delta1Linear);
+            delta1 = _mm256_mul_ps(vh, _mm256_add_ps(_mm256_mul_ps(delta1, t), delta1Constant));
+            __m256 delta2 = _mm256_mul_ps(hh, _mm256_add_ps(_mm256_mul_ps(a6, t), delta2Constant));
+
+            __m256 derivative = _mm256_add_ps(_mm256_mul_ps(a3, t), b2);
+            derivative = _mm256_add_ps(_mm256_mul_ps(derivative, t), vc);
+            __m256 epsilon1 = _mm256_mul_ps(vh, _mm256_add_ps(_mm256_mul_ps(a6, t), epsilon1Constant));
+
+            for (int i = anchor; i < blockEnd; i += 8)
+            {
+                _mm256_storeu_ps(values[j] + i, value);
+                value = _mm256_add_ps(value, delta1);
+                delta1 = _mm256_add_ps(delta1, delta2);
+                delta2 = _mm256_add_ps(delta2, delta3);
+
+                if (derivatives)
+                {
+                    _mm256_storeu_ps(derivatives[j] + i, derivative);
+                    derivative = _mm256_add_ps(derivative, epsilon1);
+                    epsilon1 = _mm256_add_ps(epsilon1, epsilon2);
+                }
+            }
+        }
+    }
+
+    return end;
+#else
+    Q_UNUSED(coefficients);
+    Q_UNUSED(segments);
+    Q_UNUSED(values);
+    Q_UNUSED(derivatives);
+    return 0;
+#endif
+}
+
+BSplineCurves3D::BezierBatch::InstructionSet BSplineCurves3D::BezierBatch::DetectInstructionSet()
+{
+#if defined(BSPLINE_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    bool sse2 = (info[3] & (1 << 26)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+
+    bool avx2 = false;
+
+    // AVX2 also needs the operating system to save the YMM registers
+    if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+    {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+
+    if (avx2)
+        return InstructionSet::AVX2;
+
+    if (sse2)
+        return InstructionSet::SSE;
+
+    return InstructionSet::Scalar;
+#elif defined(BSPLINE_X86)
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+        return InstructionSet::AVX2;
+
+    if (__builtin_cpu_supports("sse2"))
+        return InstructionSet::SSE;
+
+    return InstructionSet::Scalar;
+#else
+    return InstructionSet::Scalar;
+#endif
+}
@@ -0,0 +1,285 @@
+#include "BufferArena.h"
+
+#include <QDebug>
+
+BSplineCurves3D::BufferArena::BufferArena()
+    : mInitialized(false)
+{}
+
+BSplineCurves3D::BufferArena* BSplineCurves3D::BufferArena::Instance()
+{
+    static BufferArena instance;
+    return &instance;
+}
+
+BSplineCurves3D::BufferArena::Allocation* BSplineCurves3D::BufferArena::Allocate(Pool pool, qint64 size)
+{
+    size = qMax(ALIGNMENT, (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT);
+
+    qint64 offset;
+    Chunk* chunk = Place(mChunks[int(pool)], size, offset);
+
+    Allocation* allocation = new Allocation;
+    allocation->pool = pool;
+    allocation->chunk = chunk;
+    allocation->buffer = &chunk->buffer;
+    allocation->offset = offset;
+    allocation->size = size;
+    allocation->generation = 0;
+
+    chunk->allocations << allocation;
+
+    return allocation;
+}
+
+BSplineCurves3D::BufferArena::Allocation* BSplineCurves3D::BufferArena::Reallocate(Allocation* allocation, Pool pool, qint64 size)
+{
+    if (allocation && allocation->pool == pool && allocation->size >= size && allocation->size <= 2 * qMax(size, ALIGNMENT))
+        return allocation;
+
+    Free(allocation);
+
+    return Allocate(pool, size);
+}
+
+void BSplineCurves3D::BufferArena::Free(Allocation* allocation)
+{
+    if (!allocation)
+        return;
+
+    Chunk* chunk = allocation->chunk;
+
+    chunk->allocations.removeOne(allocation);
+    ReleaseRange(chunk, allocation->offset, allocation->size);
+
+    delete allocation;
+}
+
+void BSplineCurves3D::BufferArena::Write(Allocation* allocation, qint64 offset, const void* data, qint64 size)
+{
+    if (size <= 0)
+        return;
+
+    allocation->buffer->bind();
+    allocation->buffer->write(allocation->offset + offset, data, size);
+    allocation->buffer->release();
+}
+
+qint64 BSplineCurves3D::BufferArena::Defragment(bool force)
+{
+    qint64 movedBytes = 0;
+
+    for (auto& chunks : mChunks)
+    {
+        for (int i = chunks.size() - 1; i >= 0; --i)
+        {
+            if (chunks[i]->allocations.isEmpty())
+            {
+                chunks[i]->buffer.destroy();
+                delete chunks.takeAt(i);
+            }
+        }
+
+        if (chunks.isEmpty() || (!force && !IsDefragmentationRequired(chunks)))
+            continue;
+
+        // Everything is copied into new chunks, copies between distinct buffers never overlap
+        QList<Chunk*> oldChunks = chunks;
+        chunks.clear();
+
+        for (auto& oldChunk : oldChunks)
+        {
+            for (auto& allocation : oldChunk->allocations)
+            {
+                qint64 offset;
+                Chunk* chunk = Place(chunks, allocation->size, offset);
+
+                glBindBuffer(GL_COPY_READ_BUFFER, oldChunk->buffer.bufferId());
+                glBindBuffer(GL_COPY_WRITE_BUFFER, chunk->buffer.bufferId());
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation->offset, offset, allocation->size);
+
+                allocation->chunk = chunk;
+                allocation->buffer = &chunk->buffer;
+                allocation->offset = offset;
+                allocation->generation++;
+                chunk->allocations << allocation;
+
+                movedBytes += allocation->size;
+            }
+
+            oldChunk->buffer.destroy();
+            delete oldChunk;
+        }
+
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    if (movedBytes > 0)
+        qInfo() << Q_FUNC_INFO << "Moved" << movedBytes << "bytes, reserved" << GetReservedBytes() << "bytes in" << GetChunkCount() << "buffers.";
+
+    return movedBytes;
+}
+
+bool BSplineCurves3D::BufferArena::IsDefragmentationRequired(const QList<Chunk*>& chunks) const
+{
+    qint64 reserved = 0;
+    qint64 used = 0;
+
+    for (const auto& chunk : chunks)
+    {
+        reserved += chunk->size;
+        used += chunk->used;
+    }
+
+    // First fit into fresh chunks leaves two consecutive chunks more than one chunk full, so after packing
+    // less than half of the pool plus half a chunk is free and packing does not trigger itself again
+    return reserved - used >= reserved / 2 + CHUNK_SIZE;
+}
+
+BSplineCurves3D::BufferArena::Chunk* BSplineCurves3D::BufferArena::Place(QList<Chunk*>& chunks, qint64 size, qint64& offset)
+{
+    for (auto& chunk : chunks)
+        if (chunk->size - chunk->used >= size && PlaceInChunk(chunk, size, offset))
+            return chunk;
+
+    Chunk* chunk = CreateChunk(qMax(CHUNK_SIZE, size));
+    chunks << chunk;
+
+    PlaceInChunk(chunk, size, offset);
+
+    return chunk;
+}
+
+bool BSplineCurves3D::BufferArena::PlaceInChunk(Chunk* chunk, qint64 size, qint64& offset)
+{
+    for (auto it = chunk->freeBlocks.begin(); it != chunk->freeBlocks.end(); ++it)
+    {
+        if (it.value() < size)
+            continue;
+
+        offset = it.key();
+        qint64 remainder = it.value() - size;
+
+        chunk->freeBlocks.erase(it);
+
+        if (remainder > 0)
+            chunk->freeBlocks.insert(offset + size, remainder);
+
+        chunk->used += size;
+
+        return true;
+    }
+
+    return false;
+}
+
+BSplineCurves3D::BufferArena::Chunk* BSplineCurves3D::BufferArena::CreateChunk(qint64 size)
+{
+    if (!mInitialized)
+    {
+        initializeOpenGLFunctions();
+        mInitialized = true;
+    }
+
+    Chunk* chunk = new Chunk;
+    chunk->size = size;
+    chunk->used = 0;
+    chunk->freeBlocks.insert(0, size);
+
+    chunk->buffer.create();
+    chunk->buffer.bind();
+    chunk->buffer.setUsagePattern(QOpenGLBuffer::UsagePattern::DynamicDraw);
+    chunk->buffer.allocate(size);
+    chunk->buffer.release();
+
+    return chunk;
+}
+
+void BSplineCurves3D::BufferArena::ReleaseRange(Chunk* chunk, qint64 offset, qint64 size)
+{
+    chunk->used -= size;
+
+    auto next = chunk->freeBlocks.lowerBound(offset);
+
+    // Merge with the following block
+    if (next != chunk->freeBlocks.end() && next.key() == offset + size)
+    {
+        size += next.value();
+        next = chunk->freeBlocks.erase(next);
+    }
+
+    // Merge with the preceding block
+    if (next != chunk->freeBlocks.begin())
+    {
+        auto previous = std::prev(next);
+
+        if (previous.key() + previous.value() == offset)
+        {
+            previous.value() += size;
+            return;
+        }
+    }
+
+    chunk->freeBlocks.insert(offset, size);
+}
+
+qint64 BSplineCurves3D::BufferArena::GetReservedBytes() const
+{
+    qint64 bytes = 0;
+
+    for (const auto& chunks : mChunks)
+        for (const auto& chunk : chunks)
+            bytes += chunk->size;
+
+    return bytes;
+}
+
+qint64 BSplineCurves3D::BufferArena::GetUsedBytes() const
+{
+    qint64 bytes = 0;
+
+    for (const auto& chunks : mChunks)
+        for (const auto& chunk : chunks)
+            bytes += chunk->used;
+
+    return bytes;
+}
+
+int BSplineCurves3D::BufferArena::GetChunkCount() const
+{
+    return mChunks[0].size() + mChunks[1].size();
+}
+
+int BSplineCurves3D::BufferArena::GetAllocationCount() const
+{
+    int count = 0;
+
+    for (const auto& chunks : mChunks)
+        for (const auto& chunk : chunks)
+            count += chunk->allocations.size();
+
+    return count;
+}
+
+float BSplineCurves3D::BufferArena::GetFragmentation() const
+{
+    qint64 free = 0;
+    qint64 largest = 0;
+
+    for (const auto& chunks : mChunks)
+    {
+        for (const auto& chunk : chunks)
+        {
+            qint64 chunkLargest = 0;
+
+            for (auto it = chunk->freeBlocks.constBegin(); it != chunk->freeBlocks.constEnd(); ++it)
+                chunkLargest = qMax(chunkLargest, it.value());
+
+            free += chunk->size - chunk->used;
+            largest += chunkLargest;
+        }
+    }
+
+    return free > 0 ? float(free - largest) / free : 0.0f;
+}
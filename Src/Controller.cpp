@@ -1,7 +1,9 @@
 #include "Controller.h"
+#include "BufferArena.h"
 #include "FreeCamera.h"
 #include "Helper.h"
 #include "Light.h"
+#include "MeshCache.h"
 #include "Window.h"
 
 #include <QDebug>
@@ -181,6 +183,18 @@ void BSplineCurves3D::Controller::OnAction(Action action, QVariant variant)
         mRendererManager->SetRenderPipes(variant.toBool());
         break;
     }
+    case Action::UpdateLevelOfDetail: {
+        mRendererManager->SetLevelOfDetail(variant.toBool());
+        break;
+    }
+    case Action::UpdateCurveMeshes: {
+        mRendererManager->SetCurveMeshes(variant.toBool());
+        break;
+    }
+    case Action::UpdateMeshCache: {
+        mCurveManager->SetMeshCache(variant.toBool());
+        break;
+    }
     case Action::UpdateKnotPointPositionFromScreen: {
         if (mSelectedKnotPoint)
         {
@@ -222,6 +236,11 @@ void BSplineCurves3D::Controller::OnAction(Action action, QVariant variant)
             mSelectedCurve->SetSectorCount(variant.toInt());
         break;
     }
+    case Action::UpdateSelectedCurveClosed: {
+        if (mSelectedCurve)
+            mSelectedCurve->SetClosed(variant.toBool());
+        break;
+    }
     case Action::UpdateGlobalPipeRadius: {
         mCurveManager->SetGlobalPipeRadius(variant.toFloat());
         break;
@@ -230,6 +249,16 @@ void BSplineCurves3D::Controller::OnAction(Action action, QVariant variant)
         mCurveManager->SetGlobalPipeSectorCount(variant.toInt());
         break;
     }
+    case Action::UpdateGlobalTessellation: {
+        QList<QVariant> values = variant.toList();
+        Bezier::Tessellation tessellation;
+        tessellation.adaptive = values[0].toBool();
+        tessellation.chordTolerance = values[1].toFloat();
+        tessellation.angleTolerance = values[2].toFloat();
+        tessellation.packedVertices = values[3].toBool();
+        mCurveManager->SetGlobalTessellation(tessellation);
+        break;
+    }
     case Action::RemoveSelectedCurve: {
         mCurveManager->RemoveCurve(mSelectedCurve);
         break;
@@ -245,6 +274,10 @@ void BSplineCurves3D::Controller::OnAction(Action action, QVariant variant)
         }
         break;
     }
+    case Action::DefragmentBufferArena: {
+        BufferArena::Instance()->Defragment(true);
+        break;
+    }
     case Action::ClearScene: {
         mCurveManager->RemoveAllCurves();
         break;
@@ -267,7 +300,8 @@ void BSplineCurves3D::Controller::OnAction(Action action, QVariant variant)
         break;
     }
     case Action::Export: {
-        Helper::SaveCurveDataToJson(mCurveManager->GetCurvesNonConst(), variant.toString());
+        if (Helper::SaveCurveDataToJson(mCurveManager->GetCurvesNonConst(), variant.toString()) && mCurveManager->GetMeshCache())
+            MeshCache::Save(variant.toString(), mCurveManager->GetCurves());
         break;
     }
     case Action::Import: {
@@ -277,7 +311,15 @@ void BSplineCurves3D::Controller::OnAction(Action action, QVariant variant)
         {
             mCurveManager->SetSelectedCurve(nullptr);
             mCurveManager->RemoveAllCurves();
+
+            // Curves restored from the cache are not solved again
+            bool cached = mCurveManager->GetMeshCache() && MeshCache::Load(variant.toString(), curves);
+
             mCurveManager->AddCurves(curves);
+
+            // Written in the background, the curves show up without waiting for it
+            if (mCurveManager->GetMeshCache() && !cached)
+                MeshCache::Save(variant.toString(), curves);
         }
         break;
     }
@@ -3,6 +3,13 @@
 BSplineCurves3D::Curve::Curve(QObject* parent)
     : QObject(parent)
     , mSelected(false)
-    , mDirty(false) {}
+    , mDirty(false)
+    , mGeneration(1) {}
 
-BSplineCurves3D::Curve::~Curve() {}
\ No newline at end of file
+BSplineCurves3D::Curve::~Curve() {}
+
+void BSplineCurves3D::Curve::MarkDirty()
+{
+    mDirty = true;
+    mGeneration++;
+}
\ No newline at end of file
@@ -1,5 +1,9 @@
 #include "CurveManager.h"
+#include "BatchSplineSolver.h"
+#include "TessellationCache.h"
+
 #include <QDebug>
+#include <QElapsedTimer>
 
 BSplineCurves3D::CurveManager::CurveManager(QObject* parent)
     : QObject(parent)
@@ -7,6 +11,9 @@ BSplineCurves3D::CurveManager::CurveManager(QObject* parent)
     , mSelectedPoint(nullptr)
     , mGlobalPipeRadius(0.125f)
     , mGlobalPipeSectorCount(128)
+    , mMeshCache(true)
+    , mLastBatchKnotCount(0)
+    , mLastBatchTime(0.0f)
 {}
 
 BSplineCurves3D::CurveManager* BSplineCurves3D::CurveManager::Instance()
@@ -28,6 +35,7 @@ QList<BSplineCurves3D::Spline*>& BSplineCurves3D::CurveManager::GetCurvesNonCons
 
 void BSplineCurves3D::CurveManager::AddCurve(Spline* curve)
 {
+    curve->SetTessellation(mGlobalTessellation);
     mCurves << curve;
 }
 
@@ -50,14 +58,58 @@ void BSplineCurves3D::CurveManager::RemoveAllCurves()
     mCurves.clear();
     SetSelectedCurve(nullptr);
     SetSelectedKnotPoint(nullptr);
+
+    // The mapped meshes of a loaded mesh cache belong to these curves, the file is closed together with their patches
+    TessellationCache::Instance()->ClearMapped();
 }
 
 void BSplineCurves3D::CurveManager::AddCurves(QList<Spline*> curves)
 {
     for (auto& curve : curves)
     {
+        curve->SetTessellation(mGlobalTessellation);
         mCurves << curve;
     }
+
+    UpdateCurves(curves);
+}
+
+void BSplineCurves3D::CurveManager::UpdateCurves(const QList<Spline*>& curves)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<BatchSplineSolver::System> systems;
+    QList<Spline*> solvedCurves;
+    qint64 knotCount = 0;
+
+    for (auto& curve : curves)
+    {
+        // E.g. restored from a MeshCache
+        if (!curve->GetDirty())
+            continue;
+
+        if (curve->IsSolveRequired())
+        {
+            systems << BatchSplineSolver::System { curve->GetKnotPointPositions(), curve->GetClosed(), QVector<QVector3D>() };
+            solvedCurves << curve;
+            knotCount += systems.last().knots.size();
+        }
+        else
+        {
+            curve->Update();
+        }
+    }
+
+    BatchSplineSolver::Solve(systems);
+
+    for (int i = 0; i < solvedCurves.size(); ++i)
+        solvedCurves[i]->SetSplineControlPoints(systems[i].solution);
+
+    mLastBatchKnotCount = knotCount;
+    mLastBatchTime = timer.nsecsElapsed() / 1000000.0f;
+
+    qInfo() << Q_FUNC_INFO << "Solved" << knotCount << "knots of" << solvedCurves.size() << "curves in" << mLastBatchTime << "ms," << GetLastBatchKnotsPerSecond() << "knots/s.";
 }
 
 BSplineCurves3D::Spline* BSplineCurves3D::CurveManager::SelectCurve(const QVector3D& rayOrigin, const QVector3D& rayDirection, float maxDistance)
@@ -154,6 +206,24 @@ void BSplineCurves3D::CurveManager::SetGlobalPipeRadius(float newGlobalPipeRadiu
         curve->SetRadius(mGlobalPipeRadius);
 }
 
+qint64 BSplineCurves3D::CurveManager::GetLastBatchKnotCount() const
+{
+    return mLastBatchKnotCount;
+}
+
+float BSplineCurves3D::CurveManager::GetLastBatchTime() const
+{
+    return mLastBatchTime;
+}
+
+float BSplineCurves3D::CurveManager::GetLastBatchKnotsPerSecond() const
+{
+    if (mLastBatchTime <= 0.0f)
+        return 0.0f;
+
+    return 1000.0f * mLastBatchKnotCount / mLastBatchTime;
+}
+
 int BSplineCurves3D::CurveManager::GetGlobalPipeSectorCount() const
 {
     return mGlobalPipeSectorCount;
@@ -165,4 +235,37 @@ void BSplineCurves3D::CurveManager::SetGlobalPipeSectorCount(int newGlobalPipeSe
 
     for (auto& curve : mCurves)
         curve->SetSectorCount(mGlobalPipeSectorCount);
-}
\ No newline at end of file
+}
+
+const BSplineCurves3D::Bezier::Tessellation& BSplineCurves3D::CurveManager::GetGlobalTessellation() const
+{
+    return mGlobalTessellation;
+}
+
+void BSplineCurves3D::CurveManager::SetGlobalTessellation(const Bezier::Tessellation& newGlobalTessellation)
+{
+    mGlobalTessellation = newGlobalTessellation;
+
+    for (auto& curve : mCurves)
+        curve->SetTessellation(mGlobalTessellation);
+}
+
+bool BSplineCurves3D::CurveManager::GetMeshCache() const
+{
+    return mMeshCache;
+}
+
+void BSplineCurves3D::CurveManager::SetMeshCache(bool newMeshCache)
+{
+    mMeshCache = newMeshCache;
+}
+
+int BSplineCurves3D::CurveManager::GetVertexCount() const
+{
+    int count = 0;
+
+    for (auto& curve : mCurves)
+        count += curve->GetVertexCount();
+
+    return count;
+}
@@ -0,0 +1,121 @@
+#include "FactorizationCache.h"
+#include "TridiagonalSolver.h"
+
+BSplineCurves3D::FactorizationCache::FactorizationCache()
+    : mMemoryCapacity(64 * 1024 * 1024)
+    , mMemoryUsage(0)
+    , mHitCount(0)
+    , mMissCount(0)
+{}
+
+BSplineCurves3D::FactorizationCache* BSplineCurves3D::FactorizationCache::Instance()
+{
+    static FactorizationCache instance;
+
+    return &instance;
+}
+
+QSharedPointer<const QVector<float>> BSplineCurves3D::FactorizationCache::Get(int size, bool cyclic)
+{
+    Key key(size, cyclic);
+
+    {
+        QMutexLocker locker(&mMutex);
+
+        auto it = mEntries.find(key);
+
+        if (it != mEntries.end())
+        {
+            mUsage.splice(mUsage.begin(), mUsage, it.value().usage);
+            mHitCount++;
+            return it.value().factorization;
+        }
+
+        mMissCount++;
+    }
+
+    // Factorize outside of the lock so that other sizes can be served meanwhile
+    QSharedPointer<QVector<float>> factorization;
+
+    if (cyclic)
+    {
+        factorization = QSharedPointer<QVector<float>>::create(2 * size);
+        TridiagonalSolver::FactorizeCyclic(factorization->data(), size);
+    }
+    else
+    {
+        factorization = QSharedPointer<QVector<float>>::create(size);
+        TridiagonalSolver::Factorize(factorization->data(), size);
+    }
+
+    qint64 bytes = sizeof(float) * factorization->size();
+
+    QMutexLocker locker(&mMutex);
+
+    auto it = mEntries.find(key);
+
+    // Another thread might have inserted the same key in the meantime
+    if (it != mEntries.end())
+        return it.value().factorization;
+
+    if (bytes > mMemoryCapacity)
+        return factorization;
+
+    mUsage.push_front(key);
+    mEntries.insert(key, Entry { factorization, mUsage.begin() });
+    mMemoryUsage += bytes;
+
+    Evict();
+
+    return factorization;
+}
+
+void BSplineCurves3D::FactorizationCache::Clear()
+{
+    QMutexLocker locker(&mMutex);
+
+    mEntries.clear();
+    mUsage.clear();
+    mMemoryUsage = 0;
+}
+
+void BSplineCurves3D::FactorizationCache::Evict()
+{
+    while (mMemoryUsage > mMemoryCapacity && !mUsage.empty())
+    {
+        Key key = mUsage.back();
+        mUsage.pop_back();
+        mMemoryUsage -= sizeof(float) * mEntries.take(key).factorization->size();
+    }
+}
+
+qint64 BSplineCurves3D::FactorizationCache::GetMemoryCapacity() const
+{
+    QMutexLocker locker(&mMutex);
+    return mMemoryCapacity;
+}
+
+void BSplineCurves3D::FactorizationCache::SetMemoryCapacity(qint64 newMemoryCapacity)
+{
+    QMutexLocker locker(&mMutex);
+    mMemoryCapacity = newMemoryCapacity;
+    Evict();
+}
+
+qint64 BSplineCurves3D::FactorizationCache::GetMemoryUsage() const
+{
+    QMutexLocker locker(&mMutex);
+    return mMemoryUsage;
+}
+
+quint64 BSplineCurves3D::FactorizationCache::GetHitCount() const
+{
+    QMutexLocker locker(&mMutex);
+    return mHitCount;
+}
+
+quint64 BSplineCurves3D::FactorizationCache::GetMissCount() const
+{
+    QMutexLocker locker(&mMutex);
+    return mMissCount;
+}
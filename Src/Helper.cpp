@@ -55,8 +55,10 @@ QList<BSplineCurves3D::Spline*> BSplineCurves3D::Helper::LoadCurveDataFromJson(c
         QJsonArray knotsArray = curveObject["knots"].toArray();
         float r = curveObject["r"].toDouble();
         int sectorCount = curveObject["sector_count"].toInt();
+        bool closed = curveObject["closed"].toBool(false);
         curve->SetRadius(r);
         curve->SetSectorCount(sectorCount);
+        curve->SetClosed(closed);
 
         for (const auto& knotElement : qAsConst(knotsArray))
         {
@@ -101,6 +103,7 @@ bool BSplineCurves3D::Helper::SaveCurveDataToJson(const QList<Spline*>& curves,
 
         curveObject.insert("r", curve->GetRadius());
         curveObject.insert("sector_count", curve->GetSectorCount());
+        curveObject.insert("closed", curve->GetClosed());
         curveObject.insert("knots", knotsArray);
 
         curvesArray << curveObject;
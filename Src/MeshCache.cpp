@@ -0,0 +1,364 @@
+#include "MeshCache.h"
+#include "TessellationCache.h"
+#include "TessellationScheduler.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QSaveFile>
+#include <QThreadPool>
+
+#include <cstring>
+
+BSplineCurves3D::MeshCache::MeshCache() {}
+
+QString BSplineCurves3D::MeshCache::GetPath(const QString& curveFile)
+{
+    return curveFile + ".meshcache";
+}
+
+bool BSplineCurves3D::MeshCache::Load(const QString& curveFile, const QList<Spline*>& curves)
+{
+    // Resources are read-only, they never have a cache
+    if (curveFile.startsWith(":"))
+        return false;
+
+    QByteArray hash = Hash(curveFile);
+
+    if (hash.isEmpty())
+        return false;
+
+    // Deleting the file unmaps it
+    QSharedPointer<QFile> file(new QFile(GetPath(curveFile)));
+
+    if (!file->open(QIODevice::ReadOnly))
+        return false;
+
+    GetMappings() << file;
+
+    const quint64 size = file->size();
+    const uchar* data = size >= sizeof(Header) ? file->map(0, size) : nullptr;
+
+    // Every range is checked before anything is used, a truncated or foreign file is ignored
+    auto isValid = [&](quint64 offset, quint64 count, quint64 elementSize) {
+        return offset % ALIGNMENT == 0 && offset <= size && count <= (size - offset) / elementSize;
+    };
+
+    const Header* header = reinterpret_cast<const Header*>(data);
+    const CurveRecord* curveRecords = nullptr;
+    const MeshRecord* meshRecords = nullptr;
+
+    bool valid = data && std::memcmp(header->magic, MAGIC, sizeof(header->magic)) == 0 && header->version == VERSION &&
+                 std::memcmp(header->hash, hash.constData(), sizeof(header->hash)) == 0 && header->curveCount == quint32(curves.size());
+
+    if (valid)
+    {
+        quint64 curveOffset = Align(sizeof(Header));
+        quint64 meshOffset = Align(curveOffset + sizeof(CurveRecord) * header->curveCount);
+
+        valid = isValid(curveOffset, header->curveCount, sizeof(CurveRecord)) && isValid(meshOffset, header->meshCount, sizeof(MeshRecord));
+
+        curveRecords = reinterpret_cast<const CurveRecord*>(data + curveOffset);
+        meshRecords = reinterpret_cast<const MeshRecord*>(data + meshOffset);
+    }
+
+    for (quint32 i = 0; valid && i < header->curveCount; ++i)
+    {
+        const CurveRecord& record = curveRecords[i];
+        quint32 pointCount = curves[i]->IsSolveRequired() ? curves[i]->GetKnotPointPositions().size() : 0;
+
+        valid = record.pointCount == pointCount && isValid(record.pointOffset, record.pointCount, sizeof(QVector3D));
+    }
+
+    for (quint32 i = 0; valid && i < header->meshCount; ++i)
+    {
+        const MeshRecord& record = meshRecords[i];
+
+        valid = isValid(record.controlPointOffset, record.controlPointCount, sizeof(QVector3D)) &&
+                isValid(record.vertexOffset, record.vertexCount, sizeof(QVector3D)) &&
+                isValid(record.normalOffset, record.vertexCount, sizeof(QVector3D)) &&
+                isValid(record.indexOffset, record.indexCount, sizeof(quint32)) &&
+                isValid(record.packedVertexOffset, record.packedVertexCount, sizeof(PackedVertex));
+    }
+
+    if (!valid)
+    {
+        qInfo() << Q_FUNC_INFO << "Ignoring the stale or invalid mesh cache" << file->fileName();
+        return false;
+    }
+
+    for (quint32 i = 0; i < header->curveCount; ++i)
+    {
+        const CurveRecord& record = curveRecords[i];
+
+        if (record.pointCount == 0)
+            continue;
+
+        const QVector3D* points = reinterpret_cast<const QVector3D*>(data + record.pointOffset);
+        curves[i]->SetSplineControlPoints(QVector<QVector3D>(points, points + record.pointCount));
+    }
+
+    // Patches take back the frames their meshes were built with, carried frames depend on the edits that led to them
+    QList<Bezier*> patches;
+
+    for (auto& curve : curves)
+        patches << curve->GetBezierPatches();
+
+    if (patches.size() == int(header->meshCount))
+    {
+        for (int i = 0; i < patches.size(); ++i)
+        {
+            const MeshRecord& record = meshRecords[i];
+
+            patches[i]->SetFrameNormals(QVector3D(record.startNormal[0], record.startNormal[1], record.startNormal[2]),
+                                        QVector3D(record.endNormal[0], record.endNormal[1], record.endNormal[2]));
+        }
+    }
+
+    for (quint32 i = 0; i < header->meshCount; ++i)
+    {
+        const MeshRecord& record = meshRecords[i];
+        const QVector3D* controlPoints = reinterpret_cast<const QVector3D*>(data + record.controlPointOffset);
+
+        TessellationCacheKey key;
+        key.controlPoints = QVector<QVector3D>(controlPoints, controlPoints + record.controlPointCount);
+        key.tessellation.adaptive = record.flags & Adaptive;
+        key.tessellation.packedVertices = record.flags & PackedVertices;
+        key.tessellation.chordTolerance = record.chordTolerance;
+        key.tessellation.angleTolerance = record.angleTolerance;
+        key.tickCount = record.tickCount;
+        key.sectorCount = record.sectorCount;
+        key.radius = record.radius;
+        key.startNormal = QVector3D(record.startNormal[0], record.startNormal[1], record.startNormal[2]);
+        key.endNormal = QVector3D(record.endNormal[0], record.endNormal[1], record.endNormal[2]);
+
+        // No copies, the arrays point into the mapping
+        TessellationMesh mesh;
+        mesh.vertices = QVector<QVector3D>::fromRawData(reinterpret_cast<const QVector3D*>(data + record.vertexOffset), record.vertexCount);
+        mesh.normals = QVector<QVector3D>::fromRawData(reinterpret_cast<const QVector3D*>(data + record.normalOffset), record.vertexCount);
+        mesh.indices = QVector<quint32>::fromRawData(reinterpret_cast<const quint32*>(data + record.indexOffset), record.indexCount);
+        mesh.packedVertices = QVector<PackedVertex>::fromRawData(reinterpret_cast<const PackedVertex*>(data + record.packedVertexOffset), record.packedVertexCount);
+        mesh.origin = QVector3D(record.origin[0], record.origin[1], record.origin[2]);
+        mesh.scale = record.scale;
+        mesh.packed = record.flags & Packed;
+        mesh.sectorCount = record.meshSectorCount;
+        mesh.endRingShift = record.endRingShift;
+        mesh.mappedFile = file;
+
+        TessellationCache::Instance()->InsertMapped(key, mesh);
+    }
+
+    qInfo() << Q_FUNC_INFO << "Loaded" << header->curveCount << "curves and" << header->meshCount << "meshes from" << file->fileName();
+
+    return true;
+}
+
+void BSplineCurves3D::MeshCache::Save(const QString& curveFile, const QList<Spline*>& curves)
+{
+    if (curveFile.startsWith(":"))
+        return;
+
+    QByteArray hash = Hash(curveFile);
+
+    if (hash.isEmpty())
+        return;
+
+    // Everything the worker needs is taken from the curves here. Jobs get a channel of their own.
+    QVector<QVector<QVector3D>> points;
+    QVector<Entry> entries;
+    QSharedPointer<TessellationChannel> channel = QSharedPointer<TessellationChannel>::create();
+
+    for (auto& curve : curves)
+    {
+        points << (curve->IsSolveRequired() ? curve->GetSplineControlPoints() : QVector<QVector3D>());
+
+        for (auto& patch : curve->GetBezierPatches())
+        {
+            Entry entry;
+            entry.job = patch->CreateTessellationJob(0);
+            entry.job.channel = channel;
+            entry.cached = TessellationCache::Instance()->Find(entry.job, entry.mesh);
+            TessellationCache::Detach(entry.mesh);
+            entries << entry;
+
+            patch->DetachMesh();
+        }
+    }
+
+    // Published meshes nobody has taken yet, a cache hit served this frame for example
+    TessellationScheduler::Instance()->DetachPublishedMeshes();
+
+    // Nothing points into a mapping anymore, the files are closed right here
+    TessellationCache::Instance()->ClearMapped();
+
+    if (IsMapped(GetPath(curveFile)))
+    {
+        qWarning() << Q_FUNC_INFO << "Not saving, a mesh still holds the mapping of" << GetPath(curveFile);
+        return;
+    }
+
+    QThreadPool::globalInstance()->start([=]() { Write(GetPath(curveFile), hash, points, entries); });
+}
+
+void BSplineCurves3D::MeshCache::Write(const QString& path, const QByteArray& hash, const QVector<QVector<QVector3D>>& points, QVector<Entry> entries)
+{
+    for (auto& entry : entries)
+        if (!entry.cached)
+            TessellationScheduler::Tessellate(entry.job, entry.mesh);
+
+    // Offsets follow the order in which everything is written below
+    Header header;
+    std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.curveCount = points.size();
+    header.meshCount = entries.size();
+    header.reserved = 0;
+    std::memcpy(header.hash, hash.constData(), sizeof(header.hash));
+
+    QVector<CurveRecord> curveRecords(points.size());
+    QVector<MeshRecord> meshRecords(entries.size());
+
+    quint64 offset = Align(sizeof(Header));
+    offset = Align(offset + sizeof(CurveRecord) * curveRecords.size());
+    offset = Align(offset + sizeof(MeshRecord) * meshRecords.size());
+
+    for (int i = 0; i < points.size(); ++i)
+    {
+        CurveRecord& record = curveRecords[i];
+        record.pointCount = points[i].size();
+        record.pointOffset = offset;
+        record.reserved = 0;
+        offset = Align(offset + sizeof(QVector3D) * record.pointCount);
+    }
+
+    for (int i = 0; i < entries.size(); ++i)
+    {
+        const TessellationJob& job = entries[i].job;
+        const TessellationMesh& mesh = entries[i].mesh;
+        MeshRecord& record = meshRecords[i];
+
+        record.controlPointCount = job.controlPoints.size();
+        record.vertexCount = mesh.vertices.size();
+        record.indexCount = mesh.indices.size();
+        record.packedVertexCount = mesh.packedVertices.size();
+        record.tickCount = job.tickCount;
+        record.sectorCount = job.sectorCount;
+        record.radius = job.radius;
+        record.startNormal[0] = job.startNormal.x();
+        record.startNormal[1] = job.startNormal.y();
+        record.startNormal[2] = job.startNormal.z();
+        record.endNormal[0] = job.endNormal.x();
+        record.endNormal[1] = job.endNormal.y();
+        record.endNormal[2] = job.endNormal.z();
+        record.chordTolerance = job.tessellation.chordTolerance;
+        record.angleTolerance = job.tessellation.angleTolerance;
+        record.flags = (job.tessellation.adaptive ? Adaptive : 0) | (job.tessellation.packedVertices ? PackedVertices : 0) | (mesh.packed ? Packed : 0);
+        record.meshSectorCount = mesh.sectorCount;
+        record.endRingShift = mesh.endRingShift;
+        record.origin[0] = mesh.origin.x();
+        record.origin[1] = mesh.origin.y();
+        record.origin[2] = mesh.origin.z();
+        record.scale = mesh.scale;
+
+        record.controlPointOffset = offset;
+        offset = Align(offset + sizeof(QVector3D) * record.controlPointCount);
+        record.vertexOffset = offset;
+        offset = Align(offset + sizeof(QVector3D) * record.vertexCount);
+        record.normalOffset = offset;
+        offset = Align(offset + sizeof(QVector3D) * record.vertexCount);
+        record.indexOffset = offset;
+        offset = Align(offset + sizeof(quint32) * record.indexCount);
+        record.packedVertexOffset = offset;
+        offset = Align(offset + sizeof(PackedVertex) * record.packedVertexCount);
+    }
+
+    // Written next to the curve file and renamed when complete, a reader never sees half a cache
+    QSaveFile file(path);
+
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning() << Q_FUNC_INFO << "Couldn't write to file" << file.fileName();
+        return;
+    }
+
+    quint64 position = 0;
+
+    auto write = [&](const void* data, quint64 bytes) {
+        static const char padding[ALIGNMENT] = {};
+
+        file.write(reinterpret_cast<const char*>(data), bytes);
+        position += bytes;
+
+        quint64 aligned = Align(position);
+        file.write(padding, aligned - position);
+        position = aligned;
+    };
+
+    write(&header, sizeof(Header));
+    write(curveRecords.constData(), sizeof(CurveRecord) * curveRecords.size());
+    write(meshRecords.constData(), sizeof(MeshRecord) * meshRecords.size());
+
+    for (int i = 0; i < points.size(); ++i)
+        write(points[i].constData(), sizeof(QVector3D) * curveRecords[i].pointCount);
+
+    for (int i = 0; i < entries.size(); ++i)
+    {
+        const TessellationMesh& mesh = entries[i].mesh;
+
+        write(entries[i].job.controlPoints.constData(), sizeof(QVector3D) * meshRecords[i].controlPointCount);
+        write(mesh.vertices.constData(), sizeof(QVector3D) * meshRecords[i].vertexCount);
+        write(mesh.normals.constData(), sizeof(QVector3D) * meshRecords[i].vertexCount);
+        write(mesh.indices.constData(), sizeof(quint32) * meshRecords[i].indexCount);
+        write(mesh.packedVertices.constData(), sizeof(PackedVertex) * meshRecords[i].packedVertexCount);
+    }
+
+    if (position != offset || !file.commit())
+    {
+        qWarning() << Q_FUNC_INFO << "Couldn't write to file" << file.fileName();
+        return;
+    }
+
+    qInfo() << Q_FUNC_INFO << "Saved" << points.size() << "curves and" << entries.size() << "meshes," << position << "bytes, to" << file.fileName();
+}
+
+QByteArray BSplineCurves3D::MeshCache::Hash(const QString& curveFile)
+{
+    QFile file(curveFile);
+
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(&file);
+
+    return hash.result();
+}
+
+quint64 BSplineCurves3D::MeshCache::Align(quint64 offset)
+{
+    return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+QList<QWeakPointer<QFile>>& BSplineCurves3D::MeshCache::GetMappings()
+{
+    static QList<QWeakPointer<QFile>> mappings;
+
+    return mappings;
+}
+
+bool BSplineCurves3D::MeshCache::IsMapped(const QString& path)
+{
+    QList<QWeakPointer<QFile>>& mappings = GetMappings();
+    bool mapped = false;
+
+    for (int i = mappings.size() - 1; i >= 0; --i)
+    {
+        QSharedPointer<QFile> file = mappings[i].toStrongRef();
+
+        if (!file)
+            mappings.removeAt(i);
+        else if (file->fileName() == path)
+            mapped = true;
+    }
+
+    return mapped;
+}
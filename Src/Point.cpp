@@ -5,18 +5,24 @@ BSplineCurves3D::Point::Point(QObject *parent)
     : QObject(parent)
     , mSelected(false)
     , mPosition(0, 0, 0)
+    , mOwner(nullptr)
+    , mGeneration(1)
 {}
 
 BSplineCurves3D::Point::Point(float x, float y, float z, QObject *parent)
     : QObject(parent)
     , mSelected(false)
     , mPosition(x, y, z)
+    , mOwner(nullptr)
+    , mGeneration(1)
 {}
 
 BSplineCurves3D::Point::Point(const QVector3D &position, QObject *parent)
     : QObject(parent)
     , mSelected(false)
     , mPosition(position)
+    , mOwner(nullptr)
+    , mGeneration(1)
 {}
 
 bool BSplineCurves3D::Point::GetSelected() const
@@ -36,10 +42,27 @@ const QVector3D &BSplineCurves3D::Point::GetPosition() const
 
 void BSplineCurves3D::Point::SetPosition(const QVector3D &newPosition)
 {
+    if (mPosition == newPosition)
+        return;
+
     mPosition = newPosition;
+    mGeneration++;
+
+    if (mOwner)
+        mOwner->MarkDirty();
+}
 
-    Curve *curve = dynamic_cast<Curve *>(parent());
+BSplineCurves3D::Curve *BSplineCurves3D::Point::GetOwner() const
+{
+    return mOwner;
+}
 
-    if (curve)
-        curve->SetDirty(true);
+void BSplineCurves3D::Point::SetOwner(Curve *newOwner)
+{
+    mOwner = newOwner;
+}
+
+quint64 BSplineCurves3D::Point::GetGeneration() const
+{
+    return mGeneration;
 }
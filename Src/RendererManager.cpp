@@ -1,7 +1,10 @@
 #include "RendererManager.h"
 #include "Bezier.h"
+#include "BufferArena.h"
 #include "Camera.h"
 #include "Light.h"
+#include "SectorTable.h"
+#include "TessellationScheduler.h"
 
 #include <QtMath>
 
@@ -11,6 +14,14 @@ BSplineCurves3D::RendererManager::RendererManager(QObject* parent)
     , mSelectedKnotPoint(nullptr)
     , mRenderPaths(true)
     , mRenderPipes(true)
+    , mRetessellatedPatchCount(0)
+    , mMeshBytes(0)
+    , mUnindexedMeshBytes(0)
+    , mLevelOfDetail(true)
+    , mTriangleCount(0)
+    , mFullDetailTriangleCount(0)
+    , mCurveMeshes(false)
+    , mDrawCallCount(0)
 {
     mModelManager = ModelManager::Instance();
     mCameraManager = CameraManager::Instance();
@@ -92,6 +103,16 @@ void BSplineCurves3D::RendererManager::Render(float ifps)
     if (mRenderPaths)
         RenderPaths(ifps);
 
+    mRetessellatedPatchCount = 0;
+    mDrawCallCount = 0;
+    mMeshBytes = 0;
+    mUnindexedMeshBytes = 0;
+    mTriangleCount = 0;
+    mFullDetailTriangleCount = 0;
+
+    // Releases the buffers of removed pipes and packs the rest once most of the memory is free
+    BufferArena::Instance()->Defragment();
+
     if (mRenderPipes)
         RenderPipes(ifps);
 
@@ -210,7 +231,7 @@ void BSplineCurves3D::RendererManager::RenderPaths(float ifps)
             QList<Bezier*> patches = curve->GetBezierPatches();
             for (auto& patch : qAsConst(patches))
             {
-                auto controlPointPositions = patch->GetControlPointPositions();
+                const auto& controlPointPositions = patch->GetControlPoints();
 
                 mShaderManager->SetUniformValue("control_points_count", static_cast<int>(controlPointPositions.size()));
                 mShaderManager->SetUniformValueArray("control_points", controlPointPositions);
@@ -232,36 +253,124 @@ void BSplineCurves3D::RendererManager::RenderPipes(float ifps)
         {
             QList<Bezier*> patches = curve->GetBezierPatches();
 
+            // Rings are only shared between patches of the same level, so a whole curve uses the finest level of its patches
+            int curveLevelOfDetail = LEVEL_OF_DETAIL_COUNT - 1;
+
+            if (mCurveMeshes && mLevelOfDetail)
+                for (auto& patch : patches)
+                    curveLevelOfDetail = qMin(curveLevelOfDetail, SelectLevelOfDetail(patch));
+
             for (auto& patch : patches)
             {
                 if (!patch->GetInitialized())
                 {
                     patch->InitializeOpenGLStuff();
                 }
-                
-                if (patch->GetVertexGenerationStatus() == Bezier::VertexGenerationStatus::GeneratingVertices)
+
+                if (!mLevelOfDetail)
+                    patch->SetLevelOfDetail(0);
+                else
+                    patch->SetLevelOfDetail(mCurveMeshes ? curveLevelOfDetail : SelectLevelOfDetail(patch));
+
+                auto status = patch->GetVertexGenerationStatus();
+
+                // Whole curves are built from the meshes the patches hold, a patch which released its mesh tessellates again
+                if (mCurveMeshes && status == Bezier::VertexGenerationStatus::Ready && !patch->GetMesh())
+                    status = Bezier::VertexGenerationStatus::Dirty;
+
+                if (status == Bezier::VertexGenerationStatus::WaitingForOpenGLUpdate && mCurveMeshes)
                 {
-                    RenderUsingDumbShader(ifps, curve, patch);
+                    patch->TakeMesh();
                 }
-                else if (patch->GetVertexGenerationStatus() == Bezier::VertexGenerationStatus::WaitingForOpenGLUpdate)
+                else if (status == Bezier::VertexGenerationStatus::WaitingForOpenGLUpdate || (!mCurveMeshes && patch->GetMesh()))
                 {
                     patch->UpdateOpenGLStuff();
-                    RenderUsingSmartShader(ifps, curve, patch);
                 }
-                else if (patch->GetVertexGenerationStatus() == Bezier::VertexGenerationStatus::Dirty)
+                else if (status == Bezier::VertexGenerationStatus::Dirty)
                 {
-                    patch->GenerateVertices();
-                    RenderUsingDumbShader(ifps, curve, patch);
+                    // The selected curve is the one being edited, off-screen patches can wait
+                    int priority = TessellationScheduler::Hidden;
+
+                    if (curve == mSelectedCurve)
+                        priority = TessellationScheduler::Selected;
+                    else if (IsVisible(patch))
+                        priority = TessellationScheduler::Visible;
+
+                    patch->GenerateVertices(priority);
+                    mRetessellatedPatchCount++;
                 }
-                else if (patch->GetVertexGenerationStatus() == Bezier::VertexGenerationStatus::Ready)
-                {
+
+                if (mCurveMeshes)
+                    continue;
+
+                // A mesh at another level of detail is drawn until the new one arrives
+                if (patch->GetMeshValid())
                     RenderUsingSmartShader(ifps, curve, patch);
-                }
+                else
+                    RenderUsingDumbShader(ifps, curve, patch);
             }
+
+            if (!mCurveMeshes)
+                continue;
+
+            // One draw call per run of patches with current meshes, patches being retessellated are drawn on their own
+            curve->UpdateOpenGLStuff();
+
+            if (curve->GetMeshValid())
+                RenderCurveUsingSmartShader(ifps, curve);
+
+            for (int i = 0; i < patches.size(); ++i)
+                if (!curve->GetPatchDrawn(i))
+                    RenderUsingDumbShader(ifps, curve, patches[i]);
         }
     }
 }
 
+int BSplineCurves3D::RendererManager::SelectLevelOfDetail(Bezier* patch) const
+{
+    if (!mCamera)
+        return 0;
+
+    // Bounding sphere of the control points, grown by the pipe radius
+    const auto& controlPoints = patch->GetControlPoints();
+
+    if (controlPoints.isEmpty())
+        return 0;
+
+    QVector3D center = QVector3D(0, 0, 0);
+
+    for (const auto& point : controlPoints)
+        center += point;
+
+    center /= controlPoints.size();
+
+    float radius = 0.0f;
+
+    for (const auto& point : controlPoints)
+        radius = qMax(radius, (point - center).length());
+
+    radius += patch->GetRadius();
+
+    float distance = (center - mCamera->Position()).length();
+
+    if (distance <= radius)
+        return 0;
+
+    // Projected radius as a fraction of the half screen height
+    float size = radius / (distance * tan(0.5f * qDegreesToRadians(mCamera->GetVerticalFov())));
+
+    // A level is only left once the size is clearly past its threshold, so that patches near a threshold do not pop
+    int level = patch->GetLevelOfDetail();
+
+    while (level > 0 && size > LEVEL_OF_DETAIL_THRESHOLDS[level - 1] * (1.0f + LEVEL_OF_DETAIL_HYSTERESIS))
+        level--;
+
+    while (level < LEVEL_OF_DETAIL_COUNT - 1 && size < LEVEL_OF_DETAIL_THRESHOLDS[level] * (1.0f - LEVEL_OF_DETAIL_HYSTERESIS))
+        level++;
+
+    return level;
+}
+
 void BSplineCurves3D::RendererManager::RenderUsingDumbShader(float ifps, Spline* curve, Bezier* patch)
 {
     Q_UNUSED(ifps);
@@ -286,7 +395,11 @@ void BSplineCurves3D::RendererManager::RenderUsingDumbShader(float ifps, Spline*
 
     mShaderManager->SetUniformValue("dt", mPipeTicks->GetTicksDelta());
 
-    auto controlPointPositions = patch->GetControlPointPositions();
+    // The geometry shader always draws the full detail
+    mTriangleCount += 2 * patch->GetSectorCount() * mPipeTicks->GetSize();
+    mFullDetailTriangleCount += 2 * patch->GetSectorCount() * mPipeTicks->GetSize();
+
+    const auto& controlPointPositions = patch->GetControlPoints();
 
     mShaderManager->SetUniformValue("control_points_count", static_cast<int>(controlPointPositions.size()));
     mShaderManager->SetUniformValueArray("control_points", controlPointPositions);
@@ -297,20 +410,21 @@ void BSplineCurves3D::RendererManager::RenderUsingDumbShader(float ifps, Spline*
     mShaderManager->SetUniformValue("node.specular", curve->GetMaterial().GetSpecular());
     mShaderManager->SetUniformValue("node.shininess", curve->GetMaterial().GetShininess());
 
-    int n = patch->GetSectorCount();
-    float r = patch->GetRadius();
+    const SectorTable::Table& table = SectorTable::Get(patch->GetSectorCount());
 
-    for (int i = 0; i < n; i++)
-    {
-        float sectorAngle0 = 2.0f * float(i) * M_PI / n;
-        float sectorAngle1 = 2.0f * float(i + 1) * M_PI / n;
+    mShaderManager->SetUniformValue("r", patch->GetRadius());
 
-        mShaderManager->SetUniformValue("r", r);
-        mShaderManager->SetUniformValue("sector_angle_0", sectorAngle0);
-        mShaderManager->SetUniformValue("sector_angle_1", sectorAngle1);
+    for (int i = 0; i < table.sectorCount; i++)
+    {
+        mShaderManager->SetUniformValue("sector_cos_0", table.cos[i]);
+        mShaderManager->SetUniformValue("sector_sin_0", table.sin[i]);
+        mShaderManager->SetUniformValue("sector_cos_1", table.cos[i + 1]);
+        mShaderManager->SetUniformValue("sector_sin_1", table.sin[i + 1]);
         mPipeTicks->Render();
     }
 
+    mDrawCallCount += table.sectorCount;
+
     mShaderManager->Release();
 }
 
@@ -343,11 +457,113 @@ void BSplineCurves3D::RendererManager::RenderUsingSmartShader(float ifps, Spline
     mShaderManager->SetUniformValue("node.specular", curve->GetMaterial().GetSpecular());
     mShaderManager->SetUniformValue("node.shininess", curve->GetMaterial().GetShininess());
 
+    mShaderManager->SetUniformValue("packed_vertices", patch->GetPackedVertices() ? 1 : 0);
+    mShaderManager->SetUniformValue("origin", patch->GetPackedOrigin());
+    mShaderManager->SetUniformValue("scale", patch->GetPackedScale());
+
     patch->Render();
+    mDrawCallCount++;
+
+    mTriangleCount += patch->GetTriangleCount();
+    mFullDetailTriangleCount += patch->GetFullDetailTriangleCount();
+    mMeshBytes += patch->GetMeshBytes();
+    mUnindexedMeshBytes += patch->GetUnindexedMeshBytes();
+
+    mShaderManager->Release();
+}
+
+void BSplineCurves3D::RendererManager::RenderCurveUsingSmartShader(float ifps, Spline* curve)
+{
+    Q_UNUSED(ifps);
+
+    mShaderManager->Bind(ShaderManager::Shader::PipeSmart);
+
+    if (mCamera)
+    {
+        mShaderManager->SetUniformValue("projection_matrix", mCamera->GetProjectionMatrix());
+        mShaderManager->SetUniformValue("view_matrix", mCamera->GetViewMatrix());
+        mShaderManager->SetUniformValue("camera_position", mCamera->Position());
+    }
+
+    if (mLight)
+    {
+        mShaderManager->SetUniformValue("light.position", mLight->Position());
+        mShaderManager->SetUniformValue("light.color", mLight->GetColor());
+        mShaderManager->SetUniformValue("light.ambient", mLight->GetAmbient());
+        mShaderManager->SetUniformValue("light.diffuse", mLight->GetDiffuse());
+        mShaderManager->SetUniformValue("light.specular", mLight->GetSpecular());
+    }
+
+    mShaderManager->SetUniformValue("node.color", curve->GetMaterial().GetColor());
+    mShaderManager->SetUniformValue("node.ambient", curve->GetMaterial().GetAmbient());
+    mShaderManager->SetUniformValue("node.diffuse", curve->GetMaterial().GetDiffuse());
+    mShaderManager->SetUniformValue("node.specular", curve->GetMaterial().GetSpecular());
+    mShaderManager->SetUniformValue("node.shininess", curve->GetMaterial().GetShininess());
+
+    // Curve meshes are always float
+    mShaderManager->SetUniformValue("packed_vertices", 0);
+
+    curve->Render();
+    mDrawCallCount += curve->GetDrawCallCount();
+
+    mTriangleCount += curve->GetTriangleCount();
+    mFullDetailTriangleCount += curve->GetFullDetailTriangleCount();
+    mMeshBytes += curve->GetMeshBytes();
+    mUnindexedMeshBytes += curve->GetUnindexedMeshBytes();
 
     mShaderManager->Release();
 }
 
+bool BSplineCurves3D::RendererManager::IsVisible(Bezier* patch) const
+{
+    if (!mCamera)
+        return true;
+
+    // The patch lies in the bounding box of its control points, grown by the pipe radius
+    const auto& controlPoints = patch->GetControlPoints();
+
+    if (controlPoints.isEmpty())
+        return false;
+
+    QVector3D min = controlPoints[0];
+    QVector3D max = controlPoints[0];
+
+    for (const auto& point : controlPoints)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            min[i] = qMin(min[i], point[i]);
+            max[i] = qMax(max[i], point[i]);
+        }
+    }
+
+    QVector3D radius = QVector3D(1, 1, 1) * patch->GetRadius();
+    min -= radius;
+    max += radius;
+
+    QMatrix4x4 viewProjection = mCamera->GetProjectionMatrix() * mCamera->GetViewMatrix();
+
+    // Invisible if all corners are outside of the same clip plane
+    int outside[6] = { 0, 0, 0, 0, 0, 0 };
+
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        QVector4D position = viewProjection * QVector4D(corner & 1 ? max.x() : min.x(), corner & 2 ? max.y() : min.y(), corner & 4 ? max.z() : min.z(), 1.0f);
+
+        for (int i = 0; i < 3; ++i)
+        {
+            outside[2 * i] += position[i] < -position.w();
+            outside[2 * i + 1] += position[i] > position.w();
+        }
+    }
+
+    for (int i = 0; i < 6; ++i)
+        if (outside[i] == 8)
+            return false;
+
+    return true;
+}
+
 void BSplineCurves3D::RendererManager::SetRenderPipes(bool newRenderPipes)
 {
     mRenderPipes = newRenderPipes;
@@ -366,4 +582,54 @@ bool BSplineCurves3D::RendererManager::GetRenderPaths() const
 bool BSplineCurves3D::RendererManager::GetRenderPipes() const
 {
     return mRenderPipes;
-}
\ No newline at end of file
+}
+
+int BSplineCurves3D::RendererManager::GetRetessellatedPatchCount() const
+{
+    return mRetessellatedPatchCount;
+}
+
+qint64 BSplineCurves3D::RendererManager::GetMeshBytes() const
+{
+    return mMeshBytes;
+}
+
+qint64 BSplineCurves3D::RendererManager::GetUnindexedMeshBytes() const
+{
+    return mUnindexedMeshBytes;
+}
+
+bool BSplineCurves3D::RendererManager::GetLevelOfDetail() const
+{
+    return mLevelOfDetail;
+}
+
+void BSplineCurves3D::RendererManager::SetLevelOfDetail(bool newLevelOfDetail)
+{
+    mLevelOfDetail = newLevelOfDetail;
+}
+
+qint64 BSplineCurves3D::RendererManager::GetTriangleCount() const
+{
+    return mTriangleCount;
+}
+
+qint64 BSplineCurves3D::RendererManager::GetFullDetailTriangleCount() const
+{
+    return mFullDetailTriangleCount;
+}
+
+bool BSplineCurves3D::RendererManager::GetCurveMeshes() const
+{
+    return mCurveMeshes;
+}
+
+void BSplineCurves3D::RendererManager::SetCurveMeshes(bool newCurveMeshes)
+{
+    mCurveMeshes = newCurveMeshes;
+}
+
+int BSplineCurves3D::RendererManager::GetDrawCallCount() const
+{
+    return mDrawCallCount;
+}
@@ -0,0 +1,179 @@
+#include "SectorTable.h"
+#include "BezierBatch.h"
+#include "Simd.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QtMath>
+
+BSplineCurves3D::SectorTable::SectorTable() {}
+
+const BSplineCurves3D::SectorTable::Table& BSplineCurves3D::SectorTable::Get(int sectorCount)
+{
+    static QMutex mutex;
+    static QHash<int, Table*> tables;
+
+    QMutexLocker locker(&mutex);
+
+    Table* table = tables.value(sectorCount, nullptr);
+
+    if (table)
+        return *table;
+
+    table = new Table;
+    table->sectorCount = sectorCount;
+    table->cos.resize(sectorCount + 1);
+    table->sin.resize(sectorCount + 1);
+    table->cos3.resize(3 * sectorCount);
+    table->sin3.resize(3 * sectorCount);
+
+    for (int i = 0; i <= sectorCount; ++i)
+    {
+        double angle = 2.0 * M_PI * i / sectorCount;
+        table->cos[i] = i == sectorCount ? table->cos[0] : float(cos(angle));
+        table->sin[i] = i == sectorCount ? table->sin[0] : float(sin(angle));
+    }
+
+    for (int i = 0; i < 3 * sectorCount; ++i)
+    {
+        table->cos3[i] = table->cos[i / 3];
+        table->sin3[i] = table->sin[i / 3];
+    }
+
+    tables.insert(sectorCount, table);
+
+    return *table;
+}
+
+void BSplineCurves3D::SectorTable::GenerateRing(const Table& table, const QVector3D& center, const QVector3D& normal, const QVector3D& binormal, float radius, QVector3D* vertices, QVector3D* normals)
+{
+    const float c[3] = { center.x(), center.y(), center.z() };
+    const float n[3] = { normal.x(), normal.y(), normal.z() };
+    const float b[3] = { binormal.x(), binormal.y(), binormal.z() };
+
+    // QVector3D is three packed floats, the ring is one flat array of 3 * sectorCount floats
+    float* v = reinterpret_cast<float*>(vertices);
+    float* vn = reinterpret_cast<float*>(normals);
+
+    int done = 0;
+
+    switch (BezierBatch::GetInstructionSet())
+    {
+    case BezierBatch::InstructionSet::AVX2:
+        done = GenerateRingAVX2(table, c, n, b, radius, v, vn);
+        break;
+    case BezierBatch::InstructionSet::SSE:
+        done = GenerateRingSSE(table, c, n, b, radius, v, vn);
+        break;
+    case BezierBatch::InstructionSet::Scalar:
+        break;
+    }
+
+    GenerateRingScalar(table, done, c, n, b, radius, v, vn);
+}
+
+void BSplineCurves3D::SectorTable::GenerateRingScalar(const Table& table, int begin, const float* center, const float* normal, const float* binormal, float radius, float* vertices, float* normals)
+{
+    const int count = 3 * table.sectorCount;
+
+    for (int i = begin; i < count; ++i)
+    {
+        float value = table.cos3[i] * normal[i % 3] + table.sin3[i] * binormal[i % 3];
+        normals[i] = value;
+        vertices[i] = center[i % 3] + radius * value;
+    }
+}
+
+int BSplineCurves3D::SectorTable::GenerateRingSSE(const Table& table, const float* center, const float* normal, const float* binormal, float radius, float* vertices, float* normals)
+{
+#ifdef BSPLINE_X86
+    // 12 floats (4 sectors) repeat the x, y, z pattern in three registers
+    const int count = 3 * table.sectorCount;
+    const int end = count - count % 12;
+
+    __m128 c[3], n[3], b[3];
+
+    for (int k = 0; k < 3; ++k)
+    {
+        c[k] = _mm_setr_ps(center[(4 * k) % 3], center[(4 * k + 1) % 3], center[(4 * k + 2) % 3], center[(4 * k + 3) % 3]);
+        n[k] = _mm_setr_ps(normal[(4 * k) % 3], normal[(4 * k + 1) % 3], normal[(4 * k + 2) % 3], normal[(4 * k + 3) % 3]);
+        b[k] = _mm_setr_ps(binormal[(4 * k) % 3], binormal[(4 * k + 1) % 3], binormal[(4 * k + 2) % 3], binormal[(4 * k + 3) % 3]);
+    }
+
+    const __m128 r = _mm_set1_ps(radius);
+
+    for (int i = 0; i < end; i += 12)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            const int offset = i + 4 * k;
+            __m128 value = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(table.cos3.constData() + offset), n[k]), _mm_mul_ps(_mm_loadu_ps(table.sin3.constData() + offset), b[k]));
+            _mm_storeu_ps(normals + offset, value);
+            _mm_storeu_ps(vertices + offset, _mm_add_ps(c[k], _mm_mul_ps(r, value)));
+        }
+    }
+
+    return end;
+#else
+    Q_UNUSED(table);
+    Q_UNUSED(center);
+    Q_UNUSED(normal);
+    Q_UNUSED(binormal);
+    Q_UNUSED(radius);
+    Q_UNUSED(vertices);
+    Q_UNUSED(normals);
+    return 0;
+#endif
+}
+
+BSPLINE_TARGET_AVX2 int BSplineCurves3D::SectorTable::GenerateRingAVX2(const Table& table, const float* center, const float* normal, const float* binormal, float radius, float* vertices, float* normals)
+{
+#ifdef BSPLINE_X86
+    // 24 floats (8 sectors) repeat the x, y, z pattern in three registers
+    const int count = 3 * table.sectorCount;
+    const int end = count - count % 24;
+
+    __m256 c[3], n[3], b[3];
+
+    for (int k = 0; k < 3; ++k)
+    {
+        float pc[8], pn[8], pb[8];
+
+        for (int j = 0; j < 8; ++j)
+        {
+            pc[j] = center[(8 * k + j) % 3];
+            pn[j] = normal[(8 * k + j) % 3];
+            pb[j] = binormal[(8 * k + j) % 3];
+        }
+
+        c[k] = _mm256_loadu_ps(pc);
+        n[k] = _mm256_loadu_ps(pn);
+        b[k] = _mm256_loadu_ps(pb);
+    }
+
+    const __m256 r = _mm256_set1_ps(radius);
+
+    for (int i = 0; i < end; i += 24)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            const int offset = i + 8 * k;
+            __m256 value = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(table.cos3.constData() + offset), n[k]), _mm256_mul_ps(_mm256_loadu_ps(table.sin3.constData() + offset), b[k]));
+            _mm256_storeu_ps(normals + offset, value);
+            _mm256_storeu_ps(vertices + offset, _mm256_add_ps(c[k], _mm256_mul_ps(r, value)));
+        }
+    }
+
+    return end;
+#else
+    Q_UNUSED(table);
+    Q_UNUSED(center);
+    Q_UNUSED(normal);
+    Q_UNUSED(binormal);
+    Q_UNUSED(radius);
+    Q_UNUSED(vertices);
+    Q_UNUSED(normals);
+    return 0;
+#endif
+}
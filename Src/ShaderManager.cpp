@@ -162,8 +162,10 @@ bool BSplineCurves3D::ShaderManager::Init()
 
         locations.insert("dt", shader->uniformLocation("dt"));
         locations.insert("r", shader->uniformLocation("r"));
-        locations.insert("sector_angle_0", shader->uniformLocation("sector_angle_0"));
-        locations.insert("sector_angle_1", shader->uniformLocation("sector_angle_1"));
+        locations.insert("sector_cos_0", shader->uniformLocation("sector_cos_0"));
+        locations.insert("sector_sin_0", shader->uniformLocation("sector_sin_0"));
+        locations.insert("sector_cos_1", shader->uniformLocation("sector_cos_1"));
+        locations.insert("sector_sin_1", shader->uniformLocation("sector_sin_1"));
 
         locations.insert("light.color", shader->uniformLocation("light.color"));
         locations.insert("light.position", shader->uniformLocation("light.position"));
@@ -233,6 +235,10 @@ bool BSplineCurves3D::ShaderManager::Init()
         locations.insert("view_matrix", shader->uniformLocation("view_matrix"));
         locations.insert("projection_matrix", shader->uniformLocation("projection_matrix"));
 
+        locations.insert("packed_vertices", shader->uniformLocation("packed_vertices"));
+        locations.insert("origin", shader->uniformLocation("origin"));
+        locations.insert("scale", shader->uniformLocation("scale"));
+
         shader->bindAttributeLocation("position", 0);
         shader->bindAttributeLocation("normal", 1);
 
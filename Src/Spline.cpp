@@ -1,20 +1,46 @@
 #include "Spline.h"
+#include "ArcLength.h"
+#include "TessellationScheduler.h"
+#include "TridiagonalSolver.h"
 
 #include <QDebug>
+#include <QtMath>
+
+#include <algorithm>
 
 BSplineCurves3D::Spline::Spline(QObject* parent)
     : Curve(parent)
+    , mArcLengthTableGeneration(0)
+    , mLength(0.0f)
+    , mLengthGeneration(0)
+    , mIncrementalTolerance(1e-5f)
+    , mClosed(false)
     , mPointRemovedOrAdded(true)
+    , mVertexAllocation(nullptr)
+    , mIndexAllocation(nullptr)
+    , mVertexAllocationGeneration(0)
+    , mIndexAllocationGeneration(0)
+    , mOpenGLInitialized(false)
+    , mMeshVertexCount(0)
+    , mMeshIndexCount(0)
+    , mDrawnIndexCount(0)
+    , mMeshValid(false)
 {}
 
-BSplineCurves3D::Spline::~Spline() {}
+BSplineCurves3D::Spline::~Spline()
+{
+    mVertexArray.destroy();
+    BufferArena::Instance()->Free(mVertexAllocation);
+    BufferArena::Instance()->Free(mIndexAllocation);
+}
 
 void BSplineCurves3D::Spline::AddKnotPoint(KnotPoint* knotPoint)
 {
     mKnotPoints << knotPoint;
     knotPoint->setParent(this);
+    knotPoint->SetOwner(this);
 
-    mDirty = true;
+    MarkDirty();
     mPointRemovedOrAdded = true;
 }
 
@@ -25,28 +51,75 @@ void BSplineCurves3D::Spline::RemoveKnotPoint(KnotPoint* knotPoint)
     if (knotPoint)
     {
         knotPoint->setParent(nullptr);
+        knotPoint->SetOwner(nullptr);
         knotPoint->deleteLater();
     }
 
-    mDirty = true;
+    MarkDirty();
     mPointRemovedOrAdded = true;
 }
 
 void BSplineCurves3D::Spline::RecreateBezierPatches()
 {
+    // Patches are identified by the knots they connect, so inserting or removing a knot only replaces the patches
+    // around it. The others keep their vertices and OpenGL buffers.
+    QHash<PatchKnots, Bezier*> previousPatches;
+
+    for (int i = 0; i < mBezierPatches.size(); ++i)
+        previousPatches.insert(mPatchKnots[i], mBezierPatches[i]);
+
+    int n = mKnotPoints.size();
+    int patchCount = IsClosedLoop() ? n : n - 1;
+
+    mBezierPatches.clear();
+    mPatchKnots.clear();
+
+    for (int i = 0; i < patchCount; ++i)
+    {
+        PatchKnots knots(mKnotPoints[i], mKnotPoints[(i + 1) % n]);
+        mBezierPatches << previousPatches.take(knots);
+        mPatchKnots << knots;
+    }
+
+    // Patches which are gone go back to the pool before the new ones are taken from it
+    for (auto it = previousPatches.begin(); it != previousPatches.end(); ++it)
+        ReleasePatch(it.value());
+
     for (auto& patch : mBezierPatches)
     {
-        patch->deleteLater();
+        if (!patch)
+            patch = AcquirePatch();
     }
+}
 
-    mBezierPatches.clear();
+BSplineCurves3D::Bezier* BSplineCurves3D::Spline::AcquirePatch()
+{
+    Bezier* patch;
 
-    for (int i = 0; i < mKnotPoints.size() - 1; ++i)
+    if (mPatchPool.isEmpty())
     {
-        Bezier* patch = new Bezier;
+        patch = new Bezier;
         patch->setParent(this);
-        mBezierPatches << patch;
     }
+    else
+    {
+        patch = mPatchPool.takeLast();
+    }
+
+    patch->SetTessellation(mTessellation);
+
+    return patch;
+}
+
+void BSplineCurves3D::Spline::ReleasePatch(Bezier* patch)
+{
+    // A pooled patch gets new control points before it is drawn again, its mesh could only keep a mesh cache mapped
+    patch->ReleaseMesh();
+
+    if (mPatchPool.size() < MAX_PATCH_POOL_SIZE)
+        mPatchPool << patch;
+    else
+        patch->deleteLater();
 }
 
 BSplineCurves3D::KnotPoint* BSplineCurves3D::Spline::GetClosestKnotPointToRay(const QVector3D& rayOrigin, const QVector3D& rayDirection, float maxDistance)
@@ -82,49 +155,299 @@ void BSplineCurves3D::Spline::Update()
     if (mPointRemovedOrAdded)
         RecreateBezierPatches();
 
-    for (auto& patch : mBezierPatches)
-        patch->RemoveAllControlPoints();
+    int firstPatch = 0;
+    int lastPatch = mBezierPatches.size() - 1;
+
+    if (IsSolveRequired())
+    {
+        if (mPointRemovedOrAdded || mSplineControlPoints.size() != mKnotPoints.size())
+            SolveSplineControlPoints();
+        else
+            UpdateSplineControlPoints(firstPatch, lastPatch);
+    }
+
+    UpdateBezierPatches(firstPatch, lastPatch);
+}
+
+void BSplineCurves3D::Spline::SetSplineControlPoints(const QVector<QVector3D>& splineControlPoints)
+{
+    if (mPointRemovedOrAdded)
+        RecreateBezierPatches();
+
+    mSplineControlPoints = splineControlPoints;
+    mSkippedChanges.fill(0.0f, mSplineControlPoints.size());
+
+    UpdateBezierPatches(0, mBezierPatches.size() - 1);
+}
+
+const QVector<QVector3D>& BSplineCurves3D::Spline::GetSplineControlPoints() const
+{
+    return mSplineControlPoints;
+}
+
+bool BSplineCurves3D::Spline::IsSolveRequired() const
+{
+    return mKnotPoints.size() >= 4 || IsClosedLoop();
+}
+
+QVector<QVector3D> BSplineCurves3D::Spline::GetKnotPointPositions() const
+{
+    QVector<QVector3D> positions;
+    positions.reserve(mKnotPoints.size());
 
-    if (mKnotPoints.size() == 2)
+    for (auto& point : mKnotPoints)
+        positions << point->GetPosition();
+
+    return positions;
+}
+
+void BSplineCurves3D::Spline::UpdateBezierPatches(int firstPatch, int lastPatch)
+{
+    int n = mKnotPoints.size();
+
+    mKnotPositions.resize(n);
+    mKnotGenerations.resize(n);
+
+    for (int i = 0; i < n; ++i)
     {
-        for (int i = 0; i < mKnotPoints.size(); ++i)
-            mBezierPatches[0]->AddControlPoint(new ControlPoint(mKnotPoints.at(i)->GetPosition()));
+        mKnotPositions[i] = mKnotPoints.at(i)->GetPosition();
+        mKnotGenerations[i] = mKnotPoints.at(i)->GetGeneration();
+    }
+
+    // Patch ranges of closed splines may wrap around, a range longer than the spline updates every patch once
+    int patchCount = qMin(mBezierPatches.size(), lastPatch - firstPatch + 1);
+
+    mChangedPatches.resize(patchCount);
+
+    for (int i = 0; i < patchCount; ++i)
+        mChangedPatches[i] = UpdateBezierPatch((firstPatch + i + mBezierPatches.size()) % mBezierPatches.size());
+
+    UpdateFrameNormals(firstPatch, patchCount);
+
+    mPointRemovedOrAdded = false;
+    mDirty = false;
+}
+
+bool BSplineCurves3D::Spline::UpdateBezierPatch(int index)
+{
+    Bezier* patch = mBezierPatches[index];
+
+    // The last patch of a closed spline connects the last knot to the first one
+    int next = (index + 1) % mKnotPoints.size();
+
+    const QVector3D& knot0 = mKnotPoints.at(index)->GetPosition();
+    const QVector3D& knot1 = mKnotPoints.at(next)->GetPosition();
+
+    if (IsClosedLoop() || mKnotPoints.size() >= 4)
+    {
+        const QVector3D& splineControlPoint0 = mSplineControlPoints[index];
+        const QVector3D& splineControlPoint1 = mSplineControlPoints[next];
+
+        QVector3D points[4] = {
+            knot0,
+            (2.0f / 3.0f) * splineControlPoint0 + (1.0f / 3.0f) * splineControlPoint1,
+            (1.0f / 3.0f) * splineControlPoint0 + (2.0f / 3.0f) * splineControlPoint1,
+            knot1,
+        };
+
+        return patch->SetControlPoints(points, 4);
+    }
+    else if (mKnotPoints.size() == 2)
+    {
+        QVector3D points[2] = { knot0, knot1 };
+        return patch->SetControlPoints(points, 2);
     }
     else if (mKnotPoints.size() == 3)
     {
-        for (int i = 0; i < 2; i++)
+        QVector3D points[4] = {
+            knot0,
+            (2.0f / 3.0f) * knot0 + (1.0f / 3.0f) * knot1,
+            (1.0f / 3.0f) * knot0 + (2.0f / 3.0f) * knot1,
+            knot1,
+        };
+
+        return patch->SetControlPoints(points, 4);
+    }
+
+    return false;
+}
+
+void BSplineCurves3D::Spline::UpdateFrameNormals(int firstPatch, int patchCount)
+{
+    // Each knot has one normal shared by both of its patches. It is carried from the first knot along rotation
+    // minimizing frames, so a patch only takes a new normal at its end if it changed or its start normal did.
+    int n = mBezierPatches.size();
+
+    for (int i = 0; i < patchCount; ++i)
+    {
+        int index = (firstPatch + i + n) % n;
+        Bezier* patch = mBezierPatches[index];
+        Bezier* previous = index > 0 || IsClosedLoop() ? mBezierPatches[(index + n - 1) % n] : nullptr;
+        Bezier* next = index < n - 1 || IsClosedLoop() ? mBezierPatches[(index + 1) % n] : nullptr;
+
+        QVector3D startNormal = patch->GetStartNormal();
+
+        if (previous && !previous->GetEndNormal().isNull())
+            startNormal = previous->GetEndNormal();
+        else if (startNormal.isNull() || mChangedPatches[i])
+            startNormal = TessellationScheduler::ProjectNormal(startNormal, patch->TangentAt(0.0f).normalized());
+
+        if (!mChangedPatches[i] && startNormal == patch->GetStartNormal())
+            continue;
+
+        // The next patch keeps its normal unless it is about to be carried on from this one
+        QVector3D endNormal;
+        const QVector<QVector3D>& points = patch->GetControlPoints();
+
+        if (next && !next->GetStartNormal().isNull() && (i == patchCount - 1 || !mChangedPatches[i + 1]))
+            endNormal = next->GetStartNormal();
+        else
+            endNormal = TessellationScheduler::CarryNormal(points.constData(), points.size(), startNormal);
+
+        patch->SetFrameNormals(startNormal, endNormal);
+    }
+}
+
+void BSplineCurves3D::Spline::UpdateSplineControlPoints(int& firstPatch, int& lastPatch)
+{
+    int n = mKnotPoints.size();
+
+    // Find the moved knots and the largest displacement
+    int firstKnot = n;
+    int lastKnot = -1;
+    float displacement = 0.0f;
+    mMovedKnots.clear();
+
+    for (int i = 0; i < n; ++i)
+    {
+        if (mKnotPoints.at(i)->GetGeneration() != mKnotGenerations[i])
         {
-            ControlPoint* cp0 = new ControlPoint(mKnotPoints.at(i)->GetPosition());
-            ControlPoint* cp1 = new ControlPoint((2.0f / 3.0f) * mKnotPoints.at(i)->GetPosition() + (1.0f / 3.0f) * mKnotPoints.at(i + 1)->GetPosition());
-            ControlPoint* cp2 = new ControlPoint((1.0f / 3.0f) * mKnotPoints.at(i)->GetPosition() + (2.0f / 3.0f) * mKnotPoints.at(i + 1)->GetPosition());
-            ControlPoint* cp3 = new ControlPoint(mKnotPoints.at(i + 1)->GetPosition());
-
-            mBezierPatches[i]->AddControlPoint(cp0);
-            mBezierPatches[i]->AddControlPoint(cp1);
-            mBezierPatches[i]->AddControlPoint(cp2);
-            mBezierPatches[i]->AddControlPoint(cp3);
+            const QVector3D& position = mKnotPoints.at(i)->GetPosition();
+
+            firstKnot = qMin(firstKnot, i);
+            lastKnot = qMax(lastKnot, i);
+            displacement = qMax(displacement, (position - mKnotPositions[i]).length());
+            mMovedKnots << i;
         }
     }
-    else if (mKnotPoints.size() >= 4)
+
+    if (lastKnot < 0)
     {
-        QVector<QVector3D> splineControlPoints = GetSplineControlPoints();
+        firstPatch = 0;
+        lastPatch = -1;
+        return;
+    }
+
+    // A unit change of the constant of row k changes the solution at row j by at most
+    // C * p^|j - k| where p = 2 - sqrt(3) and C = 1 / (2 * sqrt(3)). A moved knot changes
+    // its constant by 6 * displacement, so rows farther than "radius" change less than the tolerance.
+    const float decay = 2.0f - std::sqrt(3.0f);
+    const float bound = 6.0f * displacement / (2.0f * std::sqrt(3.0f));
+    int radius = 1;
+
+    if (bound > mIncrementalTolerance)
+        radius = qMax(1, static_cast<int>(std::ceil(std::log(mIncrementalTolerance / bound) / std::log(decay))));
+
+    // Unknowns are the spline control points 1, ..., n - 2 of open splines and all of them for closed ones.
+    // Windows of closed splines may wrap around, hence they are indexed modulo n.
+    bool closed = IsClosedLoop();
+    int first = closed ? firstKnot - radius : qMax(1, qMin(firstKnot, n - 2) - radius);
+    int last = closed ? lastKnot + radius : qMin(n - 2, qMax(lastKnot, 1) + radius);
 
-        for (int i = 1; i < mKnotPoints.size(); ++i)
+    // Moving many knots needs a full solve anyway
+    if (2 * mMovedKnots.size() >= n)
+        last = first + n;
+
+    // Points outside of the window skip their change, the window grows to every point whose skipped changes add up
+    // to more than the tolerance. Otherwise many small moves, e.g. a slow drag, drift arbitrarily far from the solution.
+    // The bound of a move decays geometrically from its knot and underflows to zero after a few dozen points.
+    mSkippedChanges.resize(n);
+
+    auto skip = [&](int j, float change) {
+        if (!closed && (j < 1 || j > n - 2))
+            return;
+
+        j = (j + n) % n;
+        mSkippedChanges[j] += change;
+
+        bool inside = closed ? (j - first + n) % n <= last - first : first <= j && j <= last;
+
+        if (inside || mSkippedChanges[j] <= mIncrementalTolerance)
+            return;
+
+        int after = (j - last + n) % n;
+        int before = (first - j + n) % n;
+
+        if (!closed)
+        {
+            first = qMin(first, j);
+            last = qMax(last, j);
+        }
+        else if (after <= before)
+            last += after;
+        else
+            first -= before;
+    };
+
+    for (int k = 0; k < mMovedKnots.size() && 2 * (last - first + 1) < n; ++k)
+    {
+        int i = mMovedKnots[k];
+        float change = 6.0f * (mKnotPoints.at(i)->GetPosition() - mKnotPositions[i]).length() / (2.0f * std::sqrt(3.0f));
+
+        skip(i, change);
+
+        for (int distance = 1; 2 * distance <= n && change > 0.0f; ++distance)
         {
-            ControlPoint* cp0 = new ControlPoint(mKnotPoints.at(i - 1)->GetPosition());
-            ControlPoint* cp1 = new ControlPoint((2.0f / 3.0f) * splineControlPoints[i - 1] + (1.0f / 3.0f) * splineControlPoints[i]);
-            ControlPoint* cp2 = new ControlPoint((1.0f / 3.0f) * splineControlPoints[i - 1] + (2.0f / 3.0f) * splineControlPoints[i]);
-            ControlPoint* cp3 = new ControlPoint(mKnotPoints.at(i)->GetPosition());
-
-            mBezierPatches[i - 1]->AddControlPoint(cp0);
-            mBezierPatches[i - 1]->AddControlPoint(cp1);
-            mBezierPatches[i - 1]->AddControlPoint(cp2);
-            mBezierPatches[i - 1]->AddControlPoint(cp3);
+            change *= decay;
+            skip(i + distance, change);
+
+            if (2 * distance != n)
+                skip(i - distance, change);
         }
     }
 
-    mPointRemovedOrAdded = false;
-    mDirty = false;
+    // Solving a window almost as large as the curve gains nothing
+    if (2 * (last - first + 1) >= n)
+    {
+        SolveSplineControlPoints();
+        firstPatch = 0;
+        lastPatch = mBezierPatches.size() - 1;
+        return;
+    }
+
+    if (!closed)
+    {
+        mSplineControlPoints[0] = mKnotPoints.at(0)->GetPosition();
+        mSplineControlPoints[n - 1] = mKnotPoints.at(n - 1)->GetPosition();
+    }
+
+    // Spline control points just outside of the window are kept fixed and moved to the right side
+    int size = last - first + 1;
+    mConstants.resize(size);
+    mSolution.resize(size);
+
+    for (int i = 0; i < size; ++i)
+        mConstants[i] = 6 * mKnotPoints.at((first + i + n) % n)->GetPosition();
+
+    mConstants[0] -= mSplineControlPoints[(first - 1 + n) % n];
+    mConstants[size - 1] -= mSplineControlPoints[(last + 1) % n];
+
+    TridiagonalSolver::Solve(mConstants.constData(), mSolution.data(), size);
+
+    for (int i = 0; i < size; ++i)
+        mSplineControlPoints[(first + i + n) % n] = mSolution[i];
+
+    // Solved points are exact up to the skipped changes of the fixed points next to the window, which enter the
+    // constants of the first and the last row
+    const float skippedBefore = mSkippedChanges[(first - 1 + n) % n];
+    const float skippedAfter = mSkippedChanges[(last + 1) % n];
+
+    for (int i = 0; i < size; ++i)
+        mSkippedChanges[(first + i + n) % n] = (skippedBefore * std::pow(decay, i) + skippedAfter * std::pow(decay, size - 1 - i)) / (2.0f * std::sqrt(3.0f));
+
+    // Patch i lies between spline control points i and i + 1
+    firstPatch = first - 1;
+    lastPatch = last;
 }
 
 QVector3D BSplineCurves3D::Spline::ValueAt(float t) const
@@ -148,7 +471,7 @@ void BSplineCurves3D::Spline::Translate(const QVector3D& translation)
         point->SetPosition(point->GetPosition() + translation);
     }
 
-    mDirty = true;
+    MarkDirty();
 }
 
 float BSplineCurves3D::Spline::ClosestDistanceToRay(const QVector3D& cameraPosition, const QVector3D& rayDirection, float epsilon)
@@ -170,94 +493,200 @@ float BSplineCurves3D::Spline::ClosestDistanceToRay(const QVector3D& cameraPosit
     return minDistance;
 }
 
-float BSplineCurves3D::Spline::Length()
+float BSplineCurves3D::Spline::DistanceToParameter(float distance)
 {
     if (mDirty)
         Update();
 
-    float length = 0.0f;
+    if (mArcLengthTableGeneration != mGeneration)
+        UpdateArcLengthTable();
 
-    for (auto& patch : mBezierPatches)
-    {
-        length += patch->Length();
-    }
+    return LookupParameter(distance);
+}
 
-    return length;
+QVector3D BSplineCurves3D::Spline::ValueAtDistance(float distance)
+{
+    float t = DistanceToParameter(distance);
+
+    return mBezierPatches.isEmpty() ? QVector3D(0, 0, 0) : ValueAt(t);
 }
 
-Eigen::MatrixXf BSplineCurves3D::Spline::CreateCoefficientMatrix()
+QVector<float> BSplineCurves3D::Spline::DistancesToParameters(const QVector<float>& distances)
 {
-    int n = mKnotPoints.size() - 2;
-    Eigen::MatrixXf coef(n, n);
+    if (mDirty)
+        Update();
 
-    for (int i = 0; i < n; ++i)
+    if (mArcLengthTableGeneration != mGeneration)
+        UpdateArcLengthTable();
+
+    QVector<float> parameters;
+    parameters.reserve(distances.size());
+
+    for (float distance : distances)
+        parameters << LookupParameter(distance);
+
+    return parameters;
+}
+
+QVector<QVector3D> BSplineCurves3D::Spline::ValuesAtDistances(const QVector<float>& distances)
+{
+    QVector<float> parameters = DistancesToParameters(distances);
+    QVector<QVector3D> values;
+
+    if (mBezierPatches.isEmpty())
+        return values;
+
+    values.reserve(parameters.size());
+
+    for (float t : parameters)
+        values << ValueAt(t);
+
+    return values;
+}
+
+void BSplineCurves3D::Spline::UpdateArcLengthTable()
+{
+    int patchCount = mBezierPatches.size();
+
+    mArcLengthTable.resize(patchCount * ARC_LENGTH_TABLE_RESOLUTION + 1);
+    mArcLengthTable[0] = 0.0f;
+
+    for (int i = 0; i < patchCount; ++i)
     {
-        for (int j = 0; j < n; ++j)
+        Bezier* patch = mBezierPatches[i];
+        const QVector<QVector3D>& points = patch->GetControlPoints();
+
+        // Lengths are non-negative, so the table is monotone
+        for (int j = 0; j < ARC_LENGTH_TABLE_RESOLUTION; ++j)
         {
-            coef(i, j) = 0;
+            int index = i * ARC_LENGTH_TABLE_RESOLUTION + j;
+            float t0 = float(j) / ARC_LENGTH_TABLE_RESOLUTION;
+            float t1 = float(j + 1) / ARC_LENGTH_TABLE_RESOLUTION;
+
+            mArcLengthTable[index + 1] = mArcLengthTable[index] + ArcLength::Compute(points.constData(), points.size(), t0, t1, patch->GetLengthTolerance());
         }
     }
 
-    // First row
-    coef(0, 0) = 4;
-    coef(0, 1) = 1;
+    mArcLengthTableGeneration = mGeneration;
+}
 
-    for (int i = 1; i < n - 1; ++i)
+float BSplineCurves3D::Spline::LookupParameter(float distance) const
+{
+    if (mArcLengthTable.size() < 2)
+        return 0.0f;
+
+    distance = qBound(0.0f, distance, mArcLengthTable.last());
+
+    // Last entry not after the distance
+    int index = std::upper_bound(mArcLengthTable.begin(), mArcLengthTable.end(), distance) - mArcLengthTable.begin() - 1;
+    index = qBound(0, index, int(mArcLengthTable.size()) - 2);
+
+    int patch = index / ARC_LENGTH_TABLE_RESOLUTION;
+    float dt = 1.0f / ARC_LENGTH_TABLE_RESOLUTION;
+    float t0 = (index % ARC_LENGTH_TABLE_RESOLUTION) * dt;
+    float s0 = mArcLengthTable[index];
+    float s1 = mArcLengthTable[index + 1];
+
+    float t = s1 > s0 ? t0 + dt * (distance - s0) / (s1 - s0) : t0;
+
+    // One Newton step on the local arc length removes most of the interpolation error
+    const QVector<QVector3D>& points = mBezierPatches[patch]->GetControlPoints();
+    float speed = ArcLength::Speed(points.constData(), points.size(), t);
+
+    if (speed > 0.0f)
     {
-        coef(i, i - 1) = 1;
-        coef(i, i) = 4;
-        coef(i, i + 1) = 1;
+        float length = s0 + ArcLength::Compute(points.constData(), points.size(), t0, t, mBezierPatches[patch]->GetLengthTolerance());
+        t = qBound(t0, t - (length - distance) / speed, t0 + dt);
+    }
+
+    return patch + t;
+}
+
+float BSplineCurves3D::Spline::Length()
+{
+    if (mDirty)
+        Update();
+
+    if (mLengthGeneration == mGeneration)
+        return mLength;
+
+    float length = 0.0f;
+
+    for (auto& patch : mBezierPatches)
+    {
+        length += patch->Length();
     }
 
-    // Last row
-    coef(n - 1, n - 2) = 1;
-    coef(n - 1, n - 1) = 4;
+    mLength = length;
+    mLengthGeneration = mGeneration;
 
-    return coef;
+    return length;
 }
 
-QVector<QVector3D> BSplineCurves3D::Spline::GetSplineControlPoints()
+void BSplineCurves3D::Spline::SolveSplineControlPoints()
 {
+    // Solves into the existing buffers, so repeated solves of the same size do not allocate
     int n = mKnotPoints.size();
 
-    Eigen::MatrixXf knotPoints(n, 3);
+    mSplineControlPoints.resize(n);
+    mSkippedChanges.fill(0.0f, n);
 
-    for (int i = 0; i < n; ++i)
+    if (IsClosedLoop())
     {
-        knotPoints(i, 0) = mKnotPoints.at(i)->GetPosition().x();
-        knotPoints(i, 1) = mKnotPoints.at(i)->GetPosition().y();
-        knotPoints(i, 2) = mKnotPoints.at(i)->GetPosition().z();
+        mConstants.resize(n);
+
+        for (int i = 0; i < n; ++i)
+            mConstants[i] = 6 * mKnotPoints.at(i)->GetPosition();
+
+        TridiagonalSolver::SolveCyclic(mConstants.constData(), mSplineControlPoints.data(), n);
+
+        return;
     }
 
     // Constants on the right side
-    Eigen::MatrixXf constants(n - 2, 3);
+    mConstants.resize(n - 2);
 
-    for (int j = 0; j < 3; ++j)
-    {
-        constants(0, j) = 6 * knotPoints(1, j) - knotPoints(0, j);
-        constants(n - 3, j) = 6 * knotPoints(n - 2, j) - knotPoints(n - 1, j);
-    }
+    for (int i = 0; i < n - 2; ++i)
+        mConstants[i] = 6 * mKnotPoints.at(i + 1)->GetPosition();
 
-    for (int i = 1; i < n - 3; ++i)
-    {
-        for (int j = 0; j < 3; ++j)
-        {
-            constants(i, j) = 6 * knotPoints(i + 1, j);
-        }
-    }
+    mConstants[0] -= mKnotPoints.at(0)->GetPosition();
+    mConstants[n - 3] -= mKnotPoints.at(n - 1)->GetPosition();
 
     // Compute BSpline control points
-    Eigen::MatrixXf coef = CreateCoefficientMatrix();
-    Eigen::MatrixXf controlPoints = coef.inverse() * constants;
+    mSplineControlPoints[0] = mKnotPoints.at(0)->GetPosition();
+    mSplineControlPoints[n - 1] = mKnotPoints.at(n - 1)->GetPosition();
 
-    // Result
-    QVector<QVector3D> result(n, QVector3D());
-    result[0] = QVector3D(knotPoints(0, 0), knotPoints(0, 1), knotPoints(0, 2));
-    result[n - 1] = QVector3D(knotPoints(n - 1, 0), knotPoints(n - 1, 1), knotPoints(n - 1, 2));
-    for (int i = 0; i < n - 2; ++i)
-        result[i + 1] = QVector3D(controlPoints(i, 0), controlPoints(i, 1), controlPoints(i, 2));
+    TridiagonalSolver::Solve(mConstants.constData(), mSplineControlPoints.data() + 1, n - 2);
+}
+
+bool BSplineCurves3D::Spline::IsClosedLoop() const
+{
+    return mClosed && mKnotPoints.size() >= 3;
+}
+
+bool BSplineCurves3D::Spline::GetClosed() const
+{
+    return mClosed;
+}
 
-    return result;
+void BSplineCurves3D::Spline::SetClosed(bool newClosed)
+{
+    if (mClosed == newClosed)
+        return;
+
+    mClosed = newClosed;
+    MarkDirty();
+    mPointRemovedOrAdded = true;
+}
+
+float BSplineCurves3D::Spline::GetIncrementalTolerance() const
+{
+    return mIncrementalTolerance;
+}
+
+void BSplineCurves3D::Spline::SetIncrementalTolerance(float newIncrementalTolerance)
+{
+    mIncrementalTolerance = newIncrementalTolerance;
 }
 
 float BSplineCurves3D::Spline::GetRadius() const
@@ -286,6 +715,302 @@ void BSplineCurves3D::Spline::SetSectorCount(int newSectorCount)
         patch->SetSectorCount(mSectorCount);
 }
 
+const BSplineCurves3D::Bezier::Tessellation& BSplineCurves3D::Spline::GetTessellation() const
+{
+    return mTessellation;
+}
+
+void BSplineCurves3D::Spline::SetTessellation(const Bezier::Tessellation& newTessellation)
+{
+    mTessellation = newTessellation;
+
+    for (auto& patch : mBezierPatches)
+        patch->SetTessellation(mTessellation);
+}
+
+int BSplineCurves3D::Spline::GetVertexCount() const
+{
+    int count = 0;
+
+    for (auto& patch : mBezierPatches)
+        count += patch->GetVertexCount();
+
+    return count;
+}
+
+void BSplineCurves3D::Spline::InitializeOpenGLStuff()
+{
+    initializeOpenGLFunctions();
+
+    mVertexArray.create();
+
+    mOpenGLInitialized = true;
+}
+
+void BSplineCurves3D::Spline::ConfigureVertexArray()
+{
+    const qint64 offset = mVertexAllocation->offset;
+
+    mVertexArray.bind();
+    mVertexAllocation->buffer->bind();
+
+    glVertexAttribPointer(0,
+        3,                              // Size
+        GL_FLOAT,                       // Type
+        GL_FALSE,                       // Normalized
+        sizeof(QVector3D),              // Stride
+        reinterpret_cast<void*>(offset) // Offset
+    );
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1,
+        3,                                                                      // Size
+        GL_FLOAT,                                                               // Type
+        GL_FALSE,                                                               // Normalized
+        sizeof(QVector3D),                                                      // Stride
+        reinterpret_cast<void*>(offset + sizeof(QVector3D) * mMeshVertexCount) // Offset
+    );
+    glEnableVertexAttribArray(1);
+
+    mVertexAllocation->buffer->release();
+
+    // Not released, the binding is part of the vertex array state
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndexAllocation->buffer->bufferId());
+
+    mVertexArray.release();
+
+    mVertexAllocationGeneration = mVertexAllocation->generation;
+    mIndexAllocationGeneration = mIndexAllocation->generation;
+}
+
+void BSplineCurves3D::Spline::UpdateOpenGLStuff()
+{
+    if (!mOpenGLInitialized)
+        InitializeOpenGLStuff();
+
+    int patchCount = mBezierPatches.size();
+
+    if (patchCount == 0)
+    {
+        mMeshValid = false;
+        return;
+    }
+
+    bool complete = true;
+
+    for (const auto& patch : qAsConst(mBezierPatches))
+        complete = complete && patch->GetMeshValid() && patch->GetMesh();
+
+    // Offsets only move if a patch is added, removed or changes its vertex count
+    bool layoutChanged = mMeshRanges.size() != patchCount;
+
+    for (int i = 0; i < patchCount && !layoutChanged; ++i)
+    {
+        const TessellationMesh* mesh = mBezierPatches[i]->GetMesh();
+        const MeshRange& range = mMeshRanges[i];
+
+        layoutChanged = range.patch != mBezierPatches[i] || (complete && (range.vertexCount != mesh->vertices.size() || range.indexCount != mesh->indices.size()));
+    }
+
+    // A new layout waits until every patch holds a current mesh, meanwhile the patches are drawn one by one
+    if (layoutChanged && !complete)
+    {
+        mMeshValid = false;
+        return;
+    }
+
+    if (layoutChanged)
+    {
+        mMeshRanges.resize(patchCount);
+        mMeshVertexCount = 0;
+        mMeshIndexCount = 0;
+
+        for (int i = 0; i < patchCount; ++i)
+        {
+            const TessellationMesh* mesh = mBezierPatches[i]->GetMesh();
+            MeshRange& range = mMeshRanges[i];
+
+            range.patch = mBezierPatches[i];
+            range.generation = 0;
+            range.vertexOffset = mMeshVertexCount;
+            range.vertexCount = mesh->vertices.size();
+            range.indexOffset = mMeshIndexCount;
+            range.indexCount = mesh->indices.size();
+            range.sectorCount = 0;
+            range.endRingShift = 0;
+            range.current = false;
+            range.indicesChanged = true;
+
+            mMeshVertexCount += range.vertexCount;
+            mMeshIndexCount += range.indexCount;
+        }
+
+        BufferArena* arena = BufferArena::Instance();
+        mVertexAllocation = arena->Reallocate(mVertexAllocation, BufferArena::Pool::Vertex, 2 * sizeof(QVector3D) * mMeshVertexCount);
+        mIndexAllocation = arena->Reallocate(mIndexAllocation, BufferArena::Pool::Index, sizeof(quint32) * mMeshIndexCount);
+    }
+
+    // Ranges of retessellated patches whose meshes fit into them. Packed meshes still carry their float vertices and normals.
+    for (int i = 0; i < patchCount; ++i)
+    {
+        const Bezier* patch = mBezierPatches[i];
+        const TessellationMesh* mesh = patch->GetMesh();
+        MeshRange& range = mMeshRanges[i];
+
+        range.current = patch->GetMeshValid() && mesh && range.vertexCount == mesh->vertices.size() && range.indexCount == mesh->indices.size();
+
+        if (!range.current || range.generation == mesh->generation)
+            continue;
+
+        qint64 offset = sizeof(QVector3D) * range.vertexOffset;
+        qint64 size = sizeof(QVector3D) * range.vertexCount;
+
+        BufferArena::Instance()->Write(mVertexAllocation, offset, mesh->vertices.constData(), size);
+        BufferArena::Instance()->Write(mVertexAllocation, sizeof(QVector3D) * mMeshVertexCount + offset, mesh->normals.constData(), size);
+
+        // The first ring of the next patch refers to the last ring of this one
+        if (range.sectorCount != mesh->sectorCount || range.endRingShift != mesh->endRingShift)
+            mMeshRanges[(i + 1) % patchCount].indicesChanged = true;
+
+        range.generation = mesh->generation;
+        range.sectorCount = mesh->sectorCount;
+        range.endRingShift = mesh->endRingShift;
+        range.indicesChanged = true;
+    }
+
+    // Indices of the other ranges are written once their patches have current meshes again
+    for (int i = 0; i < patchCount; ++i)
+    {
+        if (mMeshRanges[i].current && mMeshRanges[i].indicesChanged)
+        {
+            WriteMeshIndices(i);
+            mMeshRanges[i].indicesChanged = false;
+        }
+    }
+
+    // Runs of current ranges are drawn with one call each. A range whose first ring is the last ring of a stale
+    // range is drawn on its own as well, it would be stretched to the old position of the knot.
+    mDrawRanges.clear();
+    mDrawnIndexCount = 0;
+
+    for (int i = 0; i < patchCount; ++i)
+    {
+        MeshRange& range = mMeshRanges[i];
+        const MeshRange* previous = GetPreviousMeshRange(i);
+
+        range.drawn = range.current && (!previous || previous->sectorCount != range.sectorCount || previous->current);
+
+        if (!range.drawn)
+            continue;
+
+        if (!mDrawRanges.isEmpty() && mDrawRanges.last().first + mDrawRanges.last().second == range.indexOffset)
+            mDrawRanges.last().second += range.indexCount;
+        else
+            mDrawRanges << qMakePair(range.indexOffset, range.indexCount);
+
+        mDrawnIndexCount += range.indexCount;
+    }
+
+    if (layoutChanged)
+        ConfigureVertexArray();
+
+    mMeshValid = true;
+}
+
+const BSplineCurves3D::Spline::MeshRange* BSplineCurves3D::Spline::GetPreviousMeshRange(int index) const
+{
+    // The patch before the first one of a closed spline is the last one
+    if (index > 0)
+        return &mMeshRanges[index - 1];
+    else if (IsClosedLoop() && mMeshRanges.size() > 1)
+        return &mMeshRanges.last();
+
+    return nullptr;
+}
+
+void BSplineCurves3D::Spline::WriteMeshIndices(int index)
+{
+    const TessellationMesh* mesh = mBezierPatches[index]->GetMesh();
+    const MeshRange& range = mMeshRanges[index];
+    const int n = range.sectorCount;
+    const MeshRange* previous = GetPreviousMeshRange(index);
+
+    // Rings of both sides of a knot have the same frame up to a rotation by whole sectors, see TessellationMesh::endRingShift.
+    // Patches at different levels of detail keep their own first ring, it stays in the buffer but is not referenced.
+    bool shared = previous && previous->sectorCount == n;
+    int previousLastRing = shared ? previous->vertexOffset + previous->vertexCount - n : 0;
+    int shift = shared ? previous->endRingShift : 0;
+
+    mMeshIndices.resize(range.indexCount);
+
+    for (int i = 0; i < range.indexCount; ++i)
+    {
+        int vertex = mesh->indices[i];
+
+        if (shared && vertex < n)
+            mMeshIndices[i] = previousLastRing + (vertex + shift) % n;
+        else
+            mMeshIndices[i] = range.vertexOffset + vertex;
+    }
+
+    BufferArena::Instance()->Write(mIndexAllocation, sizeof(quint32) * range.indexOffset, mMeshIndices.constData(), sizeof(quint32) * range.indexCount);
+}
+
+void BSplineCurves3D::Spline::Render()
+{
+    // Moved by BufferArena::Defragment
+    if (mVertexAllocation->generation != mVertexAllocationGeneration || mIndexAllocation->generation != mIndexAllocationGeneration)
+        ConfigureVertexArray();
+
+    mVertexArray.bind();
+
+    for (const auto& range : qAsConst(mDrawRanges))
+        glDrawElements(GL_TRIANGLES, range.second, GL_UNSIGNED_INT, reinterpret_cast<void*>(mIndexAllocation->offset + sizeof(quint32) * range.first));
+
+    mVertexArray.release();
+}
+
+bool BSplineCurves3D::Spline::GetMeshValid() const
+{
+    return mMeshValid && mMeshRanges.size() == mBezierPatches.size();
+}
+
+bool BSplineCurves3D::Spline::GetPatchDrawn(int index) const
+{
+    return GetMeshValid() && mMeshRanges[index].patch == mBezierPatches[index] && mMeshRanges[index].drawn;
+}
+
+int BSplineCurves3D::Spline::GetDrawCallCount() const
+{
+    return mDrawRanges.size();
+}
+
+int BSplineCurves3D::Spline::GetTriangleCount() const
+{
+    return mDrawnIndexCount / 3;
+}
+
+qint64 BSplineCurves3D::Spline::GetFullDetailTriangleCount() const
+{
+    qint64 count = 0;
+
+    for (const auto& patch : mBezierPatches)
+        count += patch->GetFullDetailTriangleCount();
+
+    return count;
+}
+
+qint64 BSplineCurves3D::Spline::GetMeshBytes() const
+{
+    return qint64(2 * sizeof(QVector3D)) * mMeshVertexCount + qint64(sizeof(quint32)) * mMeshIndexCount;
+}
+
+qint64 BSplineCurves3D::Spline::GetUnindexedMeshBytes() const
+{
+    // Four vertices and four flat normals per quad, each quad has six indices
+    return qint64(2 * sizeof(QVector3D)) * 4 * (mMeshIndexCount / 6);
+}
+
 const QList<BSplineCurves3D::KnotPoint*>& BSplineCurves3D::Spline::GetKnotPoints()
 {
     if (mDirty)
@@ -297,6 +1022,8 @@ const QList<BSplineCurves3D::KnotPoint*>& BSplineCurves3D::Spline::GetKnotPoints
 BSplineCurves3D::Spline* BSplineCurves3D::Spline::DeepCopy()
 {
     Spline* copy = new Spline;
+    copy->SetClosed(mClosed);
+    copy->SetTessellation(mTessellation);
 
     for (auto& point : mKnotPoints)
         copy->AddKnotPoint(new KnotPoint(point->GetPosition()));
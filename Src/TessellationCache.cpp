@@ -0,0 +1,223 @@
+#include "TessellationCache.h"
+
+#include <cstring>
+
+bool BSplineCurves3D::TessellationCacheKey::operator==(const TessellationCacheKey& other) const
+{
+    // Bitwise, so that equal keys always have equal hashes
+    return controlPoints.size() == other.controlPoints.size() &&
+           std::memcmp(controlPoints.constData(), other.controlPoints.constData(), sizeof(QVector3D) * controlPoints.size()) == 0 &&
+           std::memcmp(&radius, &other.radius, sizeof(float)) == 0 &&
+           std::memcmp(&startNormal, &other.startNormal, sizeof(QVector3D)) == 0 &&
+           std::memcmp(&endNormal, &other.endNormal, sizeof(QVector3D)) == 0 &&
+           std::memcmp(&tessellation.chordTolerance, &other.tessellation.chordTolerance, sizeof(float)) == 0 &&
+           std::memcmp(&tessellation.angleTolerance, &other.tessellation.angleTolerance, sizeof(float)) == 0 &&
+           tessellation.adaptive == other.tessellation.adaptive &&
+           tessellation.packedVertices == other.tessellation.packedVertices &&
+           tickCount == other.tickCount &&
+           sectorCount == other.sectorCount;
+}
+
+size_t BSplineCurves3D::qHash(const TessellationCacheKey& key, size_t seed)
+{
+    seed = qHashBits(key.controlPoints.constData(), sizeof(QVector3D) * key.controlPoints.size(), seed);
+
+    float floats[9] = { key.radius, key.tessellation.chordTolerance, key.tessellation.angleTolerance, key.startNormal.x(), key.startNormal.y(), key.startNormal.z(), key.endNormal.x(), key.endNormal.y(), key.endNormal.z() };
+    int ints[4] = { key.tickCount, key.sectorCount, key.tessellation.adaptive, key.tessellation.packedVertices };
+
+    seed = qHashBits(floats, sizeof(floats), seed);
+    seed = qHashBits(ints, sizeof(ints), seed);
+
+    return seed;
+}
+
+BSplineCurves3D::TessellationCache::TessellationCache()
+    : mCache(DEFAULT_BUDGET)
+    , mMappedBytes(0)
+    , mHitCount(0)
+    , mMissCount(0)
+{}
+
+BSplineCurves3D::TessellationCache* BSplineCurves3D::TessellationCache::Instance()
+{
+    static TessellationCache instance;
+    return &instance;
+}
+
+bool BSplineCurves3D::TessellationCache::Find(const TessellationJob& job, TessellationMesh& mesh)
+{
+    TessellationCacheKey key = MakeKey(job);
+
+    QMutexLocker locker(&mMutex);
+
+    // Moves the entry to the front of the eviction order
+    const TessellationMesh* cached = mCache.object(key);
+
+    if (!cached)
+    {
+        auto it = mMappedMeshes.constFind(key);
+
+        if (it != mMappedMeshes.constEnd())
+            cached = &it.value();
+    }
+
+    if (!cached)
+    {
+        mMissCount++;
+        return false;
+    }
+
+    mHitCount++;
+
+    Copy(*cached, mesh);
+
+    return true;
+}
+
+void BSplineCurves3D::TessellationCache::Copy(const TessellationMesh& source, TessellationMesh& mesh)
+{
+    mesh.vertices = source.vertices;
+    mesh.normals = source.normals;
+    mesh.indices = source.indices;
+    mesh.packedVertices = source.packedVertices;
+    mesh.origin = source.origin;
+    mesh.scale = source.scale;
+    mesh.packed = source.packed;
+    mesh.sectorCount = source.sectorCount;
+    mesh.endRingShift = source.endRingShift;
+    mesh.mappedFile = source.mappedFile;
+}
+
+void BSplineCurves3D::TessellationCache::Detach(TessellationMesh& mesh)
+{
+    if (!mesh.mappedFile)
+        return;
+
+    mesh.vertices.detach();
+    mesh.normals.detach();
+    mesh.indices.detach();
+    mesh.packedVertices.detach();
+    mesh.mappedFile.reset();
+}
+
+void BSplineCurves3D::TessellationCache::Insert(const TessellationJob& job, const TessellationMesh& mesh)
+{
+    TessellationCacheKey key = MakeKey(job);
+    TessellationMesh* copy = new TessellationMesh(mesh);
+
+    QMutexLocker locker(&mMutex);
+
+    // Evicts from the back until the budget is met, meshes larger than the budget are dropped
+    mCache.insert(key, copy, GetMeshBytes(mesh));
+}
+
+void BSplineCurves3D::TessellationCache::Clear()
+{
+    QMutexLocker locker(&mMutex);
+
+    mCache.clear();
+}
+
+void BSplineCurves3D::TessellationCache::InsertMapped(const TessellationCacheKey& key, const TessellationMesh& mesh)
+{
+    QMutexLocker locker(&mMutex);
+
+    auto it = mMappedMeshes.find(key);
+
+    if (it != mMappedMeshes.end())
+    {
+        mMappedBytes -= GetMeshBytes(it.value());
+        it.value() = mesh;
+    }
+    else
+    {
+        mMappedMeshes.insert(key, mesh);
+    }
+
+    mMappedBytes += GetMeshBytes(mesh);
+}
+
+void BSplineCurves3D::TessellationCache::ClearMapped()
+{
+    QMutexLocker locker(&mMutex);
+
+    mMappedMeshes.clear();
+    mMappedBytes = 0;
+}
+
+qint64 BSplineCurves3D::TessellationCache::GetMappedBytes() const
+{
+    QMutexLocker locker(&mMutex);
+
+    return mMappedBytes;
+}
+
+int BSplineCurves3D::TessellationCache::GetMappedEntryCount() const
+{
+    QMutexLocker locker(&mMutex);
+
+    return mMappedMeshes.size();
+}
+
+qint64 BSplineCurves3D::TessellationCache::GetBudget() const
+{
+    QMutexLocker locker(&mMutex);
+
+    return mCache.maxCost();
+}
+
+void BSplineCurves3D::TessellationCache::SetBudget(qint64 newBudget)
+{
+    QMutexLocker locker(&mMutex);
+
+    mCache.setMaxCost(newBudget);
+}
+
+qint64 BSplineCurves3D::TessellationCache::GetBytes() const
+{
+    QMutexLocker locker(&mMutex);
+
+    return mCache.totalCost();
+}
+
+int BSplineCurves3D::TessellationCache::GetEntryCount() const
+{
+    QMutexLocker locker(&mMutex);
+
+    return mCache.size();
+}
+
+quint64 BSplineCurves3D::TessellationCache::GetHitCount() const
+{
+    QMutexLocker locker(&mMutex);
+
+    return mHitCount;
+}
+
+quint64 BSplineCurves3D::TessellationCache::GetMissCount() const
+{
+    QMutexLocker locker(&mMutex);
+
+    return mMissCount;
+}
+
+BSplineCurves3D::TessellationCacheKey BSplineCurves3D::TessellationCache::MakeKey(const TessellationJob& job)
+{
+    TessellationCacheKey key;
+    key.controlPoints = job.controlPoints;
+    key.tessellation = job.tessellation;
+    key.tickCount = job.tickCount;
+    key.sectorCount = job.sectorCount;
+    key.radius = job.radius;
+    key.startNormal = job.startNormal;
+    key.endNormal = job.endNormal;
+
+    return key;
+}
+
+qint64 BSplineCurves3D::TessellationCache::GetMeshBytes(const TessellationMesh& mesh)
+{
+    return qint64(sizeof(QVector3D)) * (mesh.vertices.size() + mesh.normals.size()) +
+           qint64(sizeof(quint32)) * mesh.indices.size() +
+           qint64(sizeof(PackedVertex)) * mesh.packedVertices.size();
+}
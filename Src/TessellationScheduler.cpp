@@ -0,0 +1,532 @@
+#include "TessellationScheduler.h"
+#include "SectorTable.h"
+#include "TessellationCache.h"
+
+#include <QMutexLocker>
+#include <QThread>
+#include <QtMath>
+
+BSplineCurves3D::TessellationChannel::TessellationChannel()
+{
+    TessellationScheduler::Instance()->RegisterChannel(this);
+}
+
+BSplineCurves3D::TessellationChannel::~TessellationChannel()
+{
+    TessellationScheduler::Instance()->UnregisterChannel(this);
+
+    delete published.loadAcquire();
+    delete spare.loadAcquire();
+}
+
+BSplineCurves3D::TessellationMesh* BSplineCurves3D::TessellationChannel::AcquireMesh()
+{
+    TessellationMesh* mesh = spare.fetchAndStoreAcquire(nullptr);
+
+    return mesh ? mesh : new TessellationMesh;
+}
+
+void BSplineCurves3D::TessellationChannel::ReleaseMesh(TessellationMesh* mesh)
+{
+    // A mapped mesh has no storage to reuse, recycling it would only keep the file mapped
+    if (mesh->mappedFile)
+    {
+        delete mesh;
+        return;
+    }
+
+    // Keep one mesh around so that the next job reuses its storage
+    if (!spare.testAndSetRelease(nullptr, mesh))
+        delete mesh;
+}
+
+void BSplineCurves3D::TessellationChannel::Publish(TessellationMesh* mesh)
+{
+    TessellationMesh* previous = published.fetchAndStoreRelease(mesh);
+
+    if (previous)
+        ReleaseMesh(previous);
+}
+
+BSplineCurves3D::TessellationMesh* BSplineCurves3D::TessellationChannel::Take()
+{
+    return published.fetchAndStoreAcquire(nullptr);
+}
+
+void BSplineCurves3D::TessellationChannel::DetachPublished()
+{
+    TessellationMesh* mesh = Take();
+
+    if (!mesh)
+        return;
+
+    TessellationCache::Detach(*mesh);
+
+    // A mesh published meanwhile is newer
+    if (!published.testAndSetRelease(nullptr, mesh))
+        ReleaseMesh(mesh);
+}
+
+BSplineCurves3D::TessellationScheduler::TessellationScheduler()
+    : mCompletedJobCount(0)
+    , mCancelledJobCount(0)
+{
+    // Leave a core to the render thread
+    mThreadPool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+}
+
+BSplineCurves3D::TessellationScheduler* BSplineCurves3D::TessellationScheduler::Instance()
+{
+    static TessellationScheduler instance;
+
+    return &instance;
+}
+
+void BSplineCurves3D::TessellationScheduler::Submit(const TessellationJob& job)
+{
+    {
+        QMutexLocker locker(&mMutex);
+
+        for (auto& queued : mQueue)
+        {
+            if (queued.channel == job.channel)
+            {
+                // A worker has already been started for the queued job, it picks up the new one instead
+                queued = job;
+                mCancelledJobCount.fetchAndAddRelaxed(1);
+                return;
+            }
+        }
+
+        mQueue << job;
+    }
+
+    // Every worker runs the job with the highest priority at the time it starts, not necessarily this one
+    mThreadPool.start([=]() { RunNext(); });
+}
+
+void BSplineCurves3D::TessellationScheduler::Cancel(const QSharedPointer<TessellationChannel>& channel)
+{
+    channel->generation.storeRelease(0);
+
+    QMutexLocker locker(&mMutex);
+
+    for (int i = 0; i < mQueue.size(); ++i)
+    {
+        if (mQueue[i].channel == channel)
+        {
+            // The worker started for it finds the queue one job shorter
+            mQueue.removeAt(i);
+            mCancelledJobCount.fetchAndAddRelaxed(1);
+            break;
+        }
+    }
+}
+
+void BSplineCurves3D::TessellationScheduler::RegisterChannel(TessellationChannel* channel)
+{
+    QMutexLocker locker(&mChannelMutex);
+
+    mChannels.insert(channel);
+}
+
+void BSplineCurves3D::TessellationScheduler::UnregisterChannel(TessellationChannel* channel)
+{
+    QMutexLocker locker(&mChannelMutex);
+
+    mChannels.remove(channel);
+}
+
+void BSplineCurves3D::TessellationScheduler::DetachPublishedMeshes()
+{
+    QMutexLocker locker(&mChannelMutex);
+
+    for (auto& channel : mChannels)
+        channel->DetachPublished();
+}
+
+int BSplineCurves3D::TessellationScheduler::GetQueuedJobCount() const
+{
+    QMutexLocker locker(&mMutex);
+
+    return mQueue.size();
+}
+
+quint64 BSplineCurves3D::TessellationScheduler::GetCompletedJobCount() const
+{
+    return mCompletedJobCount.loadRelaxed();
+}
+
+quint64 BSplineCurves3D::TessellationScheduler::GetCancelledJobCount() const
+{
+    return mCancelledJobCount.loadRelaxed();
+}
+
+void BSplineCurves3D::TessellationScheduler::RunNext()
+{
+    TessellationJob job;
+
+    {
+        QMutexLocker locker(&mMutex);
+
+        if (mQueue.isEmpty())
+            return;
+
+        // The queue holds at most one job per patch, a linear scan is cheap
+        int next = 0;
+
+        for (int i = 1; i < mQueue.size(); ++i)
+            if (mQueue[i].priority > mQueue[next].priority)
+                next = i;
+
+        job = mQueue.takeAt(next);
+    }
+
+    if (job.channel->generation.loadAcquire() != job.generation)
+    {
+        mCancelledJobCount.fetchAndAddRelaxed(1);
+        return;
+    }
+
+    TessellationMesh* mesh = job.channel->AcquireMesh();
+
+    if (Tessellate(job, *mesh))
+    {
+        TessellationCache::Instance()->Insert(job, *mesh);
+
+        mesh->generation = job.generation;
+        job.channel->Publish(mesh);
+        mCompletedJobCount.fetchAndAddRelaxed(1);
+    }
+    else
+    {
+        job.channel->ReleaseMesh(mesh);
+        mCancelledJobCount.fetchAndAddRelaxed(1);
+    }
+}
+
+bool BSplineCurves3D::TessellationScheduler::Tessellate(const TessellationJob& job, TessellationMesh& mesh)
+{
+    const QVector<QVector3D>& points = job.controlPoints;
+
+    // Clearing keeps the capacity of a recycled mesh
+    mesh.vertices.clear();
+    mesh.normals.clear();
+    mesh.indices.clear();
+    mesh.packedVertices.clear();
+    mesh.mappedFile.reset();
+
+    float r = job.radius;
+    int n = job.sectorCount;
+
+    // Sample all ticks at once, tangents point from the end towards the start like TangentAt
+    QVector<float> ticks;
+
+    if (job.tessellation.adaptive)
+    {
+        ticks = GenerateAdaptiveTicks(job);
+    }
+    else
+    {
+        ticks.resize(job.tickCount + 1);
+
+        for (int i = 0; i <= job.tickCount; ++i)
+            ticks[i] = float(i) / job.tickCount;
+    }
+
+    const int sampleCount = ticks.size();
+    QVector<float> samples(6 * sampleCount);
+    float* x = samples.data();
+    float* y = x + sampleCount;
+    float* z = y + sampleCount;
+    float* dx = z + sampleCount;
+    float* dy = dx + sampleCount;
+    float* dz = dy + sampleCount;
+
+    if (job.tessellation.adaptive)
+        Bezier::ValuesAt(points.constData(), points.size(), ticks.constData(), sampleCount, x, y, z, dx, dy, dz);
+    else
+        Bezier::ValuesAtUniformTicks(points.constData(), points.size(), job.tickCount, x, y, z, dx, dy, dz);
+
+    QVector<QVector3D> tangents;
+    QVector<QVector3D> frameNormals;
+    mesh.sectorCount = n;
+    mesh.endRingShift = ComputeFrames(x, y, z, dx, dy, dz, sampleCount, n, job.startNormal, job.endNormal, tangents, frameNormals);
+
+    // One ring of n vertices per tick, consecutive rings are stitched together by the index buffer
+    const SectorTable::Table& table = SectorTable::Get(n);
+
+    mesh.vertices.resize(n * sampleCount);
+    mesh.normals.resize(n * sampleCount);
+    mesh.indices.reserve(6 * n * (sampleCount - 1));
+
+    for (int tick = 0; tick < sampleCount; ++tick)
+    {
+        // Superseded or its patch was deleted
+        if (tick % CANCELLATION_CHECK_INTERVAL == 0 && job.channel->generation.loadRelaxed() != job.generation)
+            return false;
+
+        QVector3D value = QVector3D(x[tick], y[tick], z[tick]);
+        QVector3D binormal = QVector3D::crossProduct(tangents[tick], frameNormals[tick]);
+
+        // Smooth normals, the normal of a tube vertex points away from the center line
+        SectorTable::GenerateRing(table, value, frameNormals[tick], binormal, r, mesh.vertices.data() + tick * n, mesh.normals.data() + tick * n);
+    }
+
+    for (int tick = 0; tick < sampleCount - 1; ++tick)
+    {
+        quint32 ring0 = tick * n;
+        quint32 ring1 = ring0 + n;
+
+        for (int i = 0; i < n; ++i)
+        {
+            quint32 j = (i + 1) % n;
+
+            mesh.indices << ring0 + i << ring1 + i << ring0 + j;
+            mesh.indices << ring0 + j << ring1 + i << ring1 + j;
+        }
+    }
+
+    mesh.packed = job.tessellation.packedVertices;
+
+    if (mesh.packed)
+        Pack(mesh);
+
+    return true;
+}
+
+void BSplineCurves3D::TessellationScheduler::Pack(TessellationMesh& mesh)
+{
+    const int count = mesh.vertices.size();
+
+    QVector3D min = count > 0 ? mesh.vertices[0] : QVector3D(0, 0, 0);
+    QVector3D max = min;
+
+    for (const auto& vertex : qAsConst(mesh.vertices))
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            min[k] = qMin(min[k], vertex[k]);
+            max[k] = qMax(max[k], vertex[k]);
+        }
+    }
+
+    // One scale for all axes keeps the quantization error isotropic
+    QVector3D extent = 0.5f * (max - min);
+    mesh.origin = 0.5f * (min + max);
+    mesh.scale = qMax(extent.x(), qMax(extent.y(), extent.z()));
+
+    if (mesh.scale <= 0.0f)
+        mesh.scale = 1.0f;
+
+    mesh.packedVertices.resize(count);
+
+    for (int i = 0; i < count; ++i)
+    {
+        PackedVertex& packed = mesh.packedVertices[i];
+        QVector3D position = (mesh.vertices[i] - mesh.origin) / mesh.scale;
+
+        packed.position[0] = Quantize(position.x());
+        packed.position[1] = Quantize(position.y());
+        packed.position[2] = Quantize(position.z());
+        packed.position[3] = 0;
+
+        // Project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half over the diagonals
+        const QVector3D& normal = mesh.normals[i];
+        float sum = qAbs(normal.x()) + qAbs(normal.y()) + qAbs(normal.z());
+        float u = normal.x() / sum;
+        float v = normal.y() / sum;
+
+        if (normal.z() < 0.0f)
+        {
+            float foldedU = (1.0f - qAbs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+            float foldedV = (1.0f - qAbs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+            u = foldedU;
+            v = foldedV;
+        }
+
+        packed.normal[0] = Quantize(u);
+        packed.normal[1] = Quantize(v);
+    }
+}
+
+qint16 BSplineCurves3D::TessellationScheduler::Quantize(float value)
+{
+    return qint16(qRound(qBound(-1.0f, value, 1.0f) * 32767.0f));
+}
+
+int BSplineCurves3D::TessellationScheduler::ComputeFrames(const float* x, const float* y, const float* z, const float* dx, const float* dy, const float* dz, int count, int sectorCount, const QVector3D& startNormal, const QVector3D& endNormal, QVector<QVector3D>& tangents, QVector<QVector3D>& normals)
+{
+    tangents.resize(count);
+    normals.resize(count);
+
+    ComputeTangents(x, y, z, dx, dy, dz, count, tangents.data());
+
+    normals[0] = ProjectNormal(startNormal, tangents[0]);
+
+    for (int i = 0; i < count - 1; ++i)
+        normals[i + 1] = Reflect(x, y, z, tangents.constData(), i, normals[i]);
+
+    // Both patches at a knot share its normal. The end frame is twisted onto it, modulo a sector since a ring
+    // rotated by a whole sector has the same vertices, and the twist is spread along the patch.
+    QVector3D target = ProjectNormal(endNormal, tangents[count - 1]);
+    QVector3D end = normals[count - 1];
+    float twist = atan2(QVector3D::dotProduct(QVector3D::crossProduct(end, target), tangents[count - 1]), QVector3D::dotProduct(end, target));
+    float sectorAngle = 2 * M_PI / sectorCount;
+    int shift = qRound(twist / sectorAngle);
+    twist -= sectorAngle * shift;
+
+    QVector<float> distances(count);
+    distances[0] = 0.0f;
+
+    for (int i = 1; i < count; ++i)
+        distances[i] = distances[i - 1] + QVector3D(x[i] - x[i - 1], y[i] - y[i - 1], z[i] - z[i - 1]).length();
+
+    float length = distances[count - 1];
+
+    for (int i = 1; i < count; ++i)
+    {
+        float angle = twist * (length > 0.0f ? distances[i] / length : float(i) / (count - 1));
+        QVector3D binormal = QVector3D::crossProduct(tangents[i], normals[i]);
+        normals[i] = cos(angle) * normals[i] + sin(angle) * binormal;
+    }
+
+    return ((shift % sectorCount) + sectorCount) % sectorCount;
+}
+
+void BSplineCurves3D::TessellationScheduler::ComputeTangents(const float* x, const float* y, const float* z, const float* dx, const float* dy, const float* dz, int count, QVector3D* tangents)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        tangents[i] = QVector3D(dx[i], dy[i], dz[i]).normalized();
+
+        // Coincident control points give a zero derivative at the ends, the chord is the best direction there
+        if (tangents[i].isNull())
+        {
+            int j = i + 1 < count ? i + 1 : i - 1;
+            QVector3D chord = QVector3D(x[j] - x[i], y[j] - y[i], z[j] - z[i]);
+            tangents[i] = (i + 1 < count ? chord : -chord).normalized();
+        }
+
+        if (tangents[i].isNull())
+            tangents[i] = i > 0 ? tangents[i - 1] : QVector3D(1, 0, 0);
+    }
+}
+
+QVector3D BSplineCurves3D::TessellationScheduler::Reflect(const float* x, const float* y, const float* z, const QVector3D* tangents, int i, const QVector3D& normal)
+{
+    // Reflect the frame onto the next point, then reflect its tangent onto the next tangent
+    QVector3D v1 = QVector3D(x[i + 1] - x[i], y[i + 1] - y[i], z[i + 1] - z[i]);
+    float c1 = QVector3D::dotProduct(v1, v1);
+
+    QVector3D reflected = normal;
+    QVector3D tangent = tangents[i];
+
+    if (c1 > 0.0f)
+    {
+        reflected -= (2.0f / c1) * QVector3D::dotProduct(v1, reflected) * v1;
+        tangent -= (2.0f / c1) * QVector3D::dotProduct(v1, tangent) * v1;
+    }
+
+    QVector3D v2 = tangents[i + 1] - tangent;
+    float c2 = QVector3D::dotProduct(v2, v2);
+
+    if (c2 > 0.0f)
+        reflected -= (2.0f / c2) * QVector3D::dotProduct(v2, reflected) * v2;
+
+    // Keep the frame orthonormal against rounding
+    return (reflected - QVector3D::dotProduct(reflected, tangents[i + 1]) * tangents[i + 1]).normalized();
+}
+
+QVector3D BSplineCurves3D::TessellationScheduler::CarryNormal(const QVector3D* points, int pointCount, const QVector3D& normal)
+{
+    constexpr int COUNT = CARRY_SEGMENTS + 1;
+
+    float samples[6][COUNT];
+    QVector3D tangents[COUNT];
+
+    Bezier::ValuesAtUniformTicks(points, pointCount, CARRY_SEGMENTS, samples[0], samples[1], samples[2], samples[3], samples[4], samples[5]);
+    ComputeTangents(samples[0], samples[1], samples[2], samples[3], samples[4], samples[5], COUNT, tangents);
+
+    QVector3D carried = ProjectNormal(normal, tangents[0]);
+
+    for (int i = 0; i < COUNT - 1; ++i)
+        carried = Reflect(samples[0], samples[1], samples[2], tangents, i, carried);
+
+    return carried;
+}
+
+QVector3D BSplineCurves3D::TessellationScheduler::ProjectNormal(const QVector3D& normal, const QVector3D& tangent)
+{
+    QVector3D projected = normal - QVector3D::dotProduct(normal, tangent) * tangent;
+
+    // Also catches a null normal
+    if (projected.lengthSquared() < 1e-6f)
+        return ReferenceNormal(tangent);
+
+    return projected.normalized();
+}
+
+QVector3D BSplineCurves3D::TessellationScheduler::ReferenceNormal(const QVector3D& tangent)
+{
+    // Up axis projected onto the normal plane, X if the tangent is too close to the up axis
+    QVector3D axis = qAbs(tangent.z()) < 0.9f ? QVector3D(0, 0, 1) : QVector3D(1, 0, 0);
+
+    return (axis - QVector3D::dotProduct(axis, tangent) * tangent).normalized();
+}
+
+QVector<float> BSplineCurves3D::TessellationScheduler::GenerateAdaptiveTicks(const TessellationJob& job)
+{
+    QVector<float> ticks;
+    ticks << 0.0f;
+
+    // Start from two halves so that a symmetric S-bend cannot pass the chord test with its midpoint on the chord
+    QVector3D value0, valueMid, value1;
+    QVector3D tangent0, tangentMid, tangent1;
+
+    ValueAndTangentAt(job, 0.0f, value0, tangent0);
+    ValueAndTangentAt(job, 0.5f, valueMid, tangentMid);
+    ValueAndTangentAt(job, 1.0f, value1, tangent1);
+
+    Subdivide(job, 0.0f, value0, tangent0, 0.5f, valueMid, tangentMid, 1, ticks);
+    Subdivide(job, 0.5f, valueMid, tangentMid, 1.0f, value1, tangent1, 1, ticks);
+
+    return ticks;
+}
+
+void BSplineCurves3D::TessellationScheduler::Subdivide(const TessellationJob& job, float t0, const QVector3D& value0, const QVector3D& tangent0, float t1, const QVector3D& value1, const QVector3D& tangent1, int depth, QVector<float>& ticks)
+{
+    float t = 0.5f * (t0 + t1);
+    QVector3D value, tangent;
+    ValueAndTangentAt(job, t, value, tangent);
+
+    // Chord height: distance of the midpoint to the chord
+    QVector3D chord = value1 - value0;
+    float chordLength = chord.length();
+    float height = chordLength > 0.0f ? QVector3D::crossProduct(value - value0, chord).length() / chordLength : (value - value0).length();
+
+    // Degenerate tangents (coincident control points) do not contribute to the angle test
+    float angle = 0.0f;
+
+    if (!tangent0.isNull() && !tangent1.isNull())
+        angle = qRadiansToDegrees(acos(qBound(-1.0f, QVector3D::dotProduct(tangent0, tangent1), 1.0f)));
+
+    if (depth < Bezier::MAX_SUBDIVISION_DEPTH && (height > job.tessellation.chordTolerance || angle > job.tessellation.angleTolerance))
+    {
+        Subdivide(job, t0, value0, tangent0, t, value, tangent, depth + 1, ticks);
+        Subdivide(job, t, value, tangent, t1, value1, tangent1, depth + 1, ticks);
+    }
+    else
+    {
+        ticks << t1;
+    }
+}
+
+void BSplineCurves3D::TessellationScheduler::ValueAndTangentAt(const TessellationJob& job, float t, QVector3D& value, QVector3D& tangent)
+{
+    float x, y, z, dx, dy, dz;
+    Bezier::ValuesAt(job.controlPoints.constData(), job.controlPoints.size(), &t, 1, &x, &y, &z, &dx, &dy, &dz);
+
+    value = QVector3D(x, y, z);
+    tangent = -QVector3D(dx, dy, dz).normalized();
+}
@@ -0,0 +1,88 @@
+#include "TridiagonalSolver.h"
+#include "FactorizationCache.h"
+
+BSplineCurves3D::TridiagonalSolver::TridiagonalSolver() {}
+
+void BSplineCurves3D::TridiagonalSolver::Solve(const QVector3D* constants, QVector3D* solution, int size)
+{
+    if (size <= 0)
+        return;
+
+    auto factorization = FactorizationCache::Instance()->Get(size);
+
+    Solve(factorization->constData(), constants, solution, size);
+}
+
+void BSplineCurves3D::TridiagonalSolver::SolveCyclic(const QVector3D* constants, QVector3D* solution, int size)
+{
+    if (size < 3)
+        return;
+
+    auto factorization = FactorizationCache::Instance()->Get(size, true);
+    const float* correction = factorization->constData() + size;
+
+    // The cyclic matrix is A = T + u * v^T where u = (gamma, 0, ..., 0, 1) and v = (1, 0, ..., 0, 1 / gamma).
+    // With T * y = d and T * z = u the solution is x = y - z * (v . y) / (1 + v . z).
+    Solve(factorization->constData(), constants, solution, size);
+
+    QVector3D numerator = solution[0] + solution[size - 1] / CYCLIC_GAMMA;
+    float denominator = 1.0f + correction[0] + correction[size - 1] / CYCLIC_GAMMA;
+    QVector3D factor = numerator / denominator;
+
+    for (int i = 0; i < size; ++i)
+        solution[i] -= correction[i] * factor;
+}
+
+void BSplineCurves3D::TridiagonalSolver::Solve(const float* factorization, const QVector3D* constants, QVector3D* solution, int size)
+{
+    if (size <= 0)
+        return;
+
+    // Forward substitution
+    solution[0] = constants[0] * factorization[0];
+
+    for (int i = 1; i < size; ++i)
+        solution[i] = (constants[i] - solution[i - 1]) * factorization[i];
+
+    // Back substitution
+    for (int i = size - 2; i >= 0; --i)
+        solution[i] -= factorization[i] * solution[i + 1];
+}
+
+void BSplineCurves3D::TridiagonalSolver::Factorize(float* factorization, int size)
+{
+    Factorize(factorization, size, 4.0f, 4.0f);
+}
+
+void BSplineCurves3D::TridiagonalSolver::FactorizeCyclic(float* factorization, int size)
+{
+    if (size < 3)
+        return;
+
+    Factorize(factorization, size, 4.0f - CYCLIC_GAMMA, 4.0f - 1.0f / CYCLIC_GAMMA);
+
+    // Correction vector z with T * z = u
+    float* correction = factorization + size;
+
+    correction[0] = CYCLIC_GAMMA * factorization[0];
+
+    for (int i = 1; i < size - 1; ++i)
+        correction[i] = -correction[i - 1] * factorization[i];
+
+    correction[size - 1] = (1.0f - correction[size - 2]) * factorization[size - 1];
+
+    for (int i = size - 2; i >= 0; --i)
+        correction[i] -= factorization[i] * correction[i + 1];
+}
+
+void BSplineCurves3D::TridiagonalSolver::Factorize(float* factorization, int size, float firstDiagonal, float lastDiagonal)
+{
+    if (size <= 0)
+        return;
+
+    // Off-diagonal entries are 1, so the modified super-diagonal equals the reciprocal pivot
+    factorization[0] = 1.0f / firstDiagonal;
+
+    for (int i = 1; i < size; ++i)
+        factorization[i] = 1.0f / ((i == size - 1 ? lastDiagonal : 4.0f) - factorization[i - 1]);
+}
@@ -1,5 +1,9 @@
 #include "Window.h"
+#include "BufferArena.h"
 #include "Controller.h"
+#include "FactorizationCache.h"
+#include "TessellationCache.h"
+#include "TessellationScheduler.h"
 #include "qmath.h"
 
 #include <imgui.h>
@@ -34,6 +38,7 @@ void BSplineCurves3D::Window::initializeGL()
     mRendererManager = RendererManager::Instance();
     mCurveManager = CurveManager::Instance();
     mLightManager = LightManager::Instance();
+    mFactorizationCache = FactorizationCache::Instance();
 
     mCurrentTime = QDateTime::currentMSecsSinceEpoch();
     mPreviousTime = mCurrentTime;
@@ -49,8 +54,12 @@ void BSplineCurves3D::Window::paintGL()
     mActiveLight = mLightManager->GetActiveLight();
     mRenderPaths = mRendererManager->GetRenderPaths();
     mRenderPipes = mRendererManager->GetRenderPipes();
+    mLevelOfDetail = mRendererManager->GetLevelOfDetail();
+    mCurveMeshes = mRendererManager->GetCurveMeshes();
     mGlobalPipeRadius = mCurveManager->GetGlobalPipeRadius();
     mGlobalPipeSectorCount = mCurveManager->GetGlobalPipeRadius();
+    mGlobalTessellation = mCurveManager->GetGlobalTessellation();
+    mMeshCache = mCurveManager->GetMeshCache();
     mSelectedCurve = mCurveManager->GetSelectedCurve();
     mSelectedKnotPoint = mCurveManager->GetSelectedKnotPoint();
 
@@ -76,6 +85,9 @@ void BSplineCurves3D::Window::paintGL()
             if (ImGui::MenuItem("Export"))
                 mController->OnAction(Action::ShowExportWindow);
 
+            if (ImGui::MenuItem("Mesh Cache", nullptr, &mMeshCache))
+                mController->OnAction(Action::UpdateMeshCache, mMeshCache);
+
             ImGui::EndMenu();
         }
         ImGui::EndMenuBar();
@@ -104,6 +116,63 @@ void BSplineCurves3D::Window::paintGL()
         if (ImGui::SliderInt("Pipe Sector Count (Global)", &mGlobalPipeSectorCount, 3, 192))
             mController->OnAction(Action::UpdateGlobalPipeSectorCount, mGlobalPipeSectorCount);
 
+        bool updateTessellation = false;
+
+        if (ImGui::Checkbox("Adaptive Tessellation", &mGlobalTessellation.adaptive))
+            updateTessellation = true;
+
+        ImGui::BeginDisabled(!mGlobalTessellation.adaptive);
+
+        if (ImGui::SliderFloat("Chord Tolerance", &mGlobalTessellation.chordTolerance, 0.0001f, 0.1f, "%.4f", ImGuiSliderFlags_Logarithmic))
+            updateTessellation = true;
+
+        if (ImGui::SliderFloat("Angle Tolerance", &mGlobalTessellation.angleTolerance, 0.5f, 45.0f, "%.1f deg"))
+            updateTessellation = true;
+
+        ImGui::EndDisabled();
+
+        if (ImGui::Checkbox("Packed Vertices", &mGlobalTessellation.packedVertices))
+            updateTessellation = true;
+
+        if (updateTessellation)
+        {
+            QList<QVariant> list;
+            list << mGlobalTessellation.adaptive;
+            list << mGlobalTessellation.chordTolerance;
+            list << mGlobalTessellation.angleTolerance;
+            list << mGlobalTessellation.packedVertices;
+            mController->OnAction(Action::UpdateGlobalTessellation, list);
+        }
+
+        if (ImGui::Checkbox("Level of Detail", &mLevelOfDetail))
+            mController->OnAction(Action::UpdateLevelOfDetail, mLevelOfDetail);
+
+        if (ImGui::Checkbox("Curve Meshes", &mCurveMeshes))
+            mController->OnAction(Action::UpdateCurveMeshes, mCurveMeshes);
+
+        ImGui::Text("Pipe Vertices: %d", mCurveManager->GetVertexCount());
+        ImGui::Text("Pipe Triangles: %lld (full detail %lld)", mRendererManager->GetTriangleCount(), mRendererManager->GetFullDetailTriangleCount());
+        ImGui::Text("Pipe Draw Calls: %d", mRendererManager->GetDrawCallCount());
+        ImGui::Text("Patches Re-tessellated: %d", mRendererManager->GetRetessellatedPatchCount());
+        ImGui::Text("Pipe Memory: %.2f MB (unindexed %.2f MB)", mRendererManager->GetMeshBytes() / 1048576.0, mRendererManager->GetUnindexedMeshBytes() / 1048576.0);
+        ImGui::Text("Tessellation Jobs Queued: %d", TessellationScheduler::Instance()->GetQueuedJobCount());
+        ImGui::Text("Tessellation Jobs Cancelled: %llu", TessellationScheduler::Instance()->GetCancelledJobCount());
+
+        quint64 hits = TessellationCache::Instance()->GetHitCount();
+        quint64 lookups = hits + TessellationCache::Instance()->GetMissCount();
+
+        ImGui::Text("Tessellation Cache: %d meshes, %.2f / %.2f MB", TessellationCache::Instance()->GetEntryCount(), TessellationCache::Instance()->GetBytes() / 1048576.0, TessellationCache::Instance()->GetBudget() / 1048576.0);
+        ImGui::Text("Mesh Cache: %d meshes, %.2f MB mapped", TessellationCache::Instance()->GetMappedEntryCount(), TessellationCache::Instance()->GetMappedBytes() / 1048576.0);
+        ImGui::Text("Tessellation Cache Hit Rate: %.1f%% (%llu / %llu)", lookups ? 100.0 * hits / lookups : 0.0, hits, lookups);
+
+        BufferArena* arena = BufferArena::Instance();
+
+        ImGui::Text("GPU Buffers: %.2f / %.2f MB in %d buffers, %d ranges", arena->GetUsedBytes() / 1048576.0, arena->GetReservedBytes() / 1048576.0, arena->GetChunkCount(), arena->GetAllocationCount());
+        ImGui::Text("GPU Buffer Fragmentation: %.1f%%", 100.0 * arena->GetFragmentation());
+
+        if (ImGui::Button("Defragment"))
+            mController->OnAction(Action::DefragmentBufferArena);
+
         if (ImGui::Checkbox("Render Paths", &mRenderPaths))
             mController->OnAction(Action::UpdateRenderPaths, mRenderPaths);
 
@@ -165,6 +234,7 @@ void BSplineCurves3D::Window::paintGL()
         float length = mSelectedCurve ? mSelectedCurve->Length() : 0.0f;
         float radius = mSelectedCurve ? mSelectedCurve->GetRadius() : 0.0f;
         int sectorCount = mSelectedCurve ? mSelectedCurve->GetSectorCount() : 0;
+        bool closed = mSelectedCurve ? mSelectedCurve->GetClosed() : false;
 
         ImGui::BeginDisabled(!mSelectedCurve);
 
@@ -177,6 +247,21 @@ void BSplineCurves3D::Window::paintGL()
         if (ImGui::SliderInt("Pipe Sector Count", &sectorCount, 3, 192))
             mController->OnAction(Action::UpdateSelectedCurvePipeSectorCount, sectorCount);
 
+        if (ImGui::Checkbox("Closed", &closed))
+            mController->OnAction(Action::UpdateSelectedCurveClosed, closed);
+
+        ImGui::Text("Vertices: %d", mSelectedCurve ? mSelectedCurve->GetVertexCount() : 0);
+
+        if (mSelectedCurve && ImGui::TreeNode("Patch Vertices"))
+        {
+            const auto& patches = mSelectedCurve->GetBezierPatches();
+
+            for (int i = 0; i < patches.size(); ++i)
+                ImGui::Text("Patch %d: %d", i, patches[i]->GetVertexCount());
+
+            ImGui::TreePop();
+        }
+
         ImGui::Text("Shading Parameters:");
         float ambient = mSelectedCurve ? mSelectedCurve->GetMaterial().GetAmbient() : 0.0f;
         float diffuse = mSelectedCurve ? mSelectedCurve->GetMaterial().GetDiffuse() : 0.0f;
@@ -251,6 +336,8 @@ void BSplineCurves3D::Window::paintGL()
 
     ImGui::Spacing();
 
+    ImGui::Text("Factorization cache: %llu hits, %llu misses", mFactorizationCache->GetHitCount(), mFactorizationCache->GetMissCount());
+    ImGui::Text("Last batch solve: %lld knots in %.2f ms (%.0f knots/s)", mCurveManager->GetLastBatchKnotCount(), mCurveManager->GetLastBatchTime(), mCurveManager->GetLastBatchKnotsPerSecond());
     ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 
     glViewport(0, 0, width(), height());